@@ -0,0 +1,983 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wnbench - Micro-benchmarks for the wmnetload sampling path and the
+ *	     arithmetic behind the display.
+ *
+ * Each benchmark is run with a growing number of iterations until it
+ * takes long enough to time, and reported on a line of its own in the
+ * same format as Go's benchmarks, so that benchstat and friends can
+ * compare runs:
+ *
+ *	Benchmark<name>	<iterations>	<ns> ns/op	<allocs> allocs/op
+ *
+ * Allocations are only counted with the GNU C library; elsewhere they
+ * are reported as -1.
+ *
+ * With `-t FILE NSAMPLES', it instead writes a synthetic trace for the
+ * replay statistics source, which the render benchmark (xbench.sh) uses
+ * to drive the dockapp.
+ *
+ * With `-c', it instead checks the /proc/net/dev parser against a
+ * straightforward strtok()/strtoull() one on a randomized table, and
+ * exits nonzero if they disagree on any field; `make check' runs this.
+ */
+
+#pragma ident "@(#)bench.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <net/if.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ifgraph.h"
+#include "ifhist.h"
+#include "ifinfo.h"
+#include "iflist.h"
+#include "ifrec.h"
+#include "ifstat.h"
+#include "utils.h"
+
+#define	WN_BENCH_MINNS	250000000LL	/* least time to run each for */
+#define	WN_BENCH_MAXN	1000000000UL	/* most iterations to run */
+
+/*
+ * Graph geometry used by the graph benchmarks (that of the current look).
+ */
+#define	WN_BENCH_COLS	16
+#define	WN_BENCH_HEIGHT	21
+#define	WN_BENCH_BPS2BAR (150 * 125 / WN_BENCH_HEIGHT)
+
+/*
+ * Number of interfaces in each synthetic /proc/net/dev or sysfs tree;
+ * sysfs trees stop at WN_BENCH_SYSFSMAX, since each interface there is a
+ * dozen files.
+ */
+static const unsigned int nifs[] = { 1, 10, 100, 1000, 10000, 100000 };
+
+#define	WN_BENCH_SYSFSMAX 10000
+
+#define	WN_BENCH_NNIFS	(sizeof (nifs) / sizeof (nifs[0]))
+
+/*
+ * Benchmarks store their results here so they can't be optimized away.
+ */
+static volatile unsigned long long sink;
+
+#ifdef	__GLIBC__
+/*
+ * Count allocations by interposing on the allocator; the GNU C library
+ * lets us, and gives us a way to get at the real one.
+ */
+extern void	*__libc_malloc(size_t);
+extern void	*__libc_calloc(size_t, size_t);
+extern void	*__libc_realloc(void *, size_t);
+
+static unsigned long nallocs;
+
+void *
+malloc(size_t size)
+{
+	nallocs++;
+	return (__libc_malloc(size));
+}
+
+void *
+calloc(size_t nelem, size_t size)
+{
+	nallocs++;
+	return (__libc_calloc(nelem, size));
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	nallocs++;
+	return (__libc_realloc(ptr, size));
+}
+#define	WN_BENCH_NALLOCS()	((long)nallocs)
+#else
+#define	WN_BENCH_NALLOCS()	(-1L)
+#endif
+
+typedef void benchfn_t(void *, unsigned long);
+
+static long long	nsnow(void);
+static void		bench_run(const char *, benchfn_t *, void *);
+static void		bench_stats(void *, unsigned long);
+static void		bench_statsall(void *, unsigned long);
+static void		bench_update(void *, unsigned long);
+static void		bench_nextbps(void *, unsigned long);
+static void		bench_graphadd(void *, unsigned long);
+static void		bench_rescale(void *, unsigned long);
+static void		bench_layout(void *, unsigned long);
+static void		bench_iflistnext(void *, unsigned long);
+static void		bench_histadd(void *, unsigned long);
+static void		bench_histnext(void *, unsigned long);
+static void		trace_write(const char *, unsigned long);
+#ifdef	WN_IFSTAT_LINUX
+static char		*procnetdev_fixture(const char *, unsigned int);
+static int		procnetdev_check(void);
+static int		procnetdev_livecheck(void);
+static unsigned long long check_ctr(void);
+static unsigned int	procnetdev_refparse(char *, char (*)[IFNAMSIZ],
+			    ifstats_t *);
+#endif
+#ifdef	WN_IFSTAT_SYSFS
+static char		*sysfs_fixture(const char *, unsigned int);
+static void		sysfs_unfixture(char *, unsigned int);
+#endif
+
+/*
+ * What the if_stats() benchmarks sample.
+ */
+typedef struct {
+	ifstat_t	*statep;	/* statistics handle */
+	char		ifname[IFNAMSIZ]; /* interface to sample */
+} statsarg_t;
+
+int
+main(int argc, char **argv)
+{
+	char		name[64];
+	ifinfo_t	*ifp;
+	ifgraph_t	*graph;
+	iflist_t	*iflp;
+	const ifstatops_t *opsp;
+	ifstats_t	stats;
+	statsarg_t	sa;
+	unsigned int	i;
+#if	defined(WN_IFSTAT_LINUX) || defined(WN_IFSTAT_SYSFS)
+	char		dir[] = "/tmp/wnbenchXXXXXX";
+	char		*path;
+#endif
+
+	progname = "wnbench";
+
+	if (argc == 4 && strcmp(argv[1], "-t") == 0) {
+		trace_write(argv[2], strtoul(argv[3], NULL, 10));
+		return (EXIT_SUCCESS);
+	}
+
+	if (argc == 2 && strcmp(argv[1], "-c") == 0) {
+#ifdef	WN_IFSTAT_LINUX
+		return (procnetdev_check() && procnetdev_livecheck() ?
+		    EXIT_SUCCESS : EXIT_FAILURE);
+#else
+		return (EXIT_SUCCESS);
+#endif
+	}
+
+	if (argc != 1) {
+		(void) fprintf(stderr, "Usage: %s [-c | -t FILE NSAMPLES]\n",
+		    progname);
+		return (EXIT_FAILURE);
+	}
+
+#ifdef	WN_IFSTAT_LINUX
+	/*
+	 * Time /proc/net/dev parsing against synthetic tables of various
+	 * sizes.  if_stats() is asked for the last interface, since that's
+	 * the worst case.
+	 */
+	if (mkdtemp(dir) == NULL)
+		die("cannot create fixture directory\n");
+
+	for (i = 0; i < WN_BENCH_NNIFS; i++) {
+		path = procnetdev_fixture(dir, nifs[i]);
+		if (setenv("WMNETLOAD_PROCNETDEV", path, 1) == -1)
+			die("cannot set fixture path\n");
+
+		sa.statep = if_statinit(&ifstat_linux_ops);
+		if (sa.statep == NULL)
+			die("cannot initialize fixture statistics\n");
+		(void) snprintf(sa.ifname, IFNAMSIZ, "if%u", nifs[i] - 1);
+
+		(void) snprintf(name, sizeof (name), "IfStats/linux/%u",
+		    nifs[i]);
+		bench_run(name, bench_stats, &sa);
+		(void) snprintf(name, sizeof (name), "IfStatsAll/linux/%u",
+		    nifs[i]);
+		bench_run(name, bench_statsall, &sa);
+
+		if_statfini(sa.statep);
+		(void) unlink(path);
+		free(path);
+	}
+	(void) rmdir(dir);
+	(void) unsetenv("WMNETLOAD_PROCNETDEV");
+#endif
+
+#ifdef	WN_IFSTAT_SYSFS
+	/*
+	 * Likewise for sysfs trees, so the two can be compared.
+	 */
+	(void) strcpy(dir, "/tmp/wnbenchXXXXXX");
+	if (mkdtemp(dir) == NULL)
+		die("cannot create fixture directory\n");
+
+	for (i = 0; i < WN_BENCH_NNIFS && nifs[i] <= WN_BENCH_SYSFSMAX; i++) {
+		path = sysfs_fixture(dir, nifs[i]);
+		if (setenv("WMNETLOAD_SYSFS", path, 1) == -1)
+			die("cannot set fixture path\n");
+
+		sa.statep = if_statinit(&ifstat_sysfs_ops);
+		if (sa.statep == NULL)
+			die("cannot initialize fixture statistics\n");
+		(void) snprintf(sa.ifname, IFNAMSIZ, "if%u", nifs[i] - 1);
+
+		(void) snprintf(name, sizeof (name), "IfStats/sysfs/%u",
+		    nifs[i]);
+		bench_run(name, bench_stats, &sa);
+		(void) snprintf(name, sizeof (name), "IfStatsAll/sysfs/%u",
+		    nifs[i]);
+		bench_run(name, bench_statsall, &sa);
+
+		if_statfini(sa.statep);
+		sysfs_unfixture(path, nifs[i]);
+	}
+	(void) rmdir(dir);
+	(void) unsetenv("WMNETLOAD_SYSFS");
+#endif
+
+	/*
+	 * Then time every live backend against the loopback interface of
+	 * this system, which is the only way to time rtnetlink.
+	 */
+	for (i = 0; (opsp = if_statbackend(i)) != NULL; i++) {
+		if (opsp->clock != NULL)
+			continue;
+
+		sa.statep = if_statinit(opsp);
+		if (sa.statep == NULL)
+			continue;
+		(void) strcpy(sa.ifname, "lo");
+
+		(void) snprintf(name, sizeof (name), "IfStats/%s/live",
+		    opsp->name);
+		if (if_stats(sa.ifname, sa.statep, &stats))
+			bench_run(name, bench_stats, &sa);
+		(void) snprintf(name, sizeof (name), "IfStatsAll/%s/live",
+		    opsp->name);
+		if (if_statsall(sa.statep) != NULL)
+			bench_run(name, bench_statsall, &sa);
+
+		if_statfini(sa.statep);
+	}
+
+	ifp = ifinfo_create("bench0", NULL);
+	bench_run("IfinfoUpdate", bench_update, ifp);
+	bench_run("NextBps", bench_nextbps, ifp);
+	ifinfo_destroy(ifp);
+
+	graph = ifgraph_create(WN_BENCH_COLS, WN_BENCH_HEIGHT,
+	    WN_BENCH_BPS2BAR, IFG_SCALEMEAN);
+	bench_run("IfGraphAdd", bench_graphadd, graph);
+	bench_run("IfGraphRescale", bench_rescale, graph);
+	ifgraph_destroy(graph);
+
+	bench_run("BpsLayout", bench_layout, NULL);
+
+	bench_run("IfHistAdd", bench_histadd, NULL);
+	bench_run("IfHistNext", bench_histnext, NULL);
+
+	iflp = iflist_init();
+	if (iflp != NULL) {
+		bench_run("IflistNext", bench_iflistnext, iflp);
+		iflist_fini(iflp);
+	}
+
+	return (EXIT_SUCCESS);
+}
+
+/*
+ * Return the current time in nanoseconds, from the monotonic clock if
+ * there is one.
+ */
+static long long
+nsnow(void)
+{
+#ifdef	CLOCK_MONOTONIC
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000LL + ts.tv_nsec);
+#else
+	struct timeval tv;
+
+	(void) gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL);
+#endif
+}
+
+/*
+ * Run benchmark `fn' on `arg', growing the iteration count until a run
+ * takes at least WN_BENCH_MINNS, and report it as `name'.
+ */
+static void
+bench_run(const char *name, benchfn_t *fn, void *arg)
+{
+	unsigned long	n = 1;
+	long long	start, ns;
+	long		allocs;
+
+	fn(arg, 1);		/* warm up */
+
+	for (;;) {
+		allocs = WN_BENCH_NALLOCS();
+		start = nsnow();
+		fn(arg, n);
+		ns = nsnow() - start;
+		if (allocs != -1)
+			allocs = WN_BENCH_NALLOCS() - allocs;
+
+		if (ns >= WN_BENCH_MINNS || n >= WN_BENCH_MAXN)
+			break;
+
+		/*
+		 * Aim for a bit over the minimum, but never grow by more
+		 * than a hundredfold at once.
+		 */
+		if (ns <= 0 || (double)WN_BENCH_MINNS * 1.2 / ns > 100)
+			n *= 100;
+		else
+			n = (double)n * WN_BENCH_MINNS * 1.2 / ns + 1;
+	}
+
+	(void) printf("Benchmark%s\t%lu\t%.1f ns/op\t%.2f allocs/op\n",
+	    name, n, (double)ns / n, allocs == -1 ? -1.0 : (double)allocs / n);
+	(void) fflush(stdout);
+}
+
+static void
+bench_stats(void *arg, unsigned long n)
+{
+	statsarg_t	*sap = arg;
+	ifstats_t	stats;
+
+	while (n-- > 0) {
+		if (if_stats(sap->ifname, sap->statep, &stats) == 0)
+			die("cannot sample %s\n", sap->ifname);
+		sink += stats.rxbytes;
+	}
+}
+
+static void
+bench_statsall(void *arg, unsigned long n)
+{
+	statsarg_t		*sap = arg;
+	const ifstatsnap_t	*snap;
+
+	while (n-- > 0) {
+		snap = if_statsall(sap->statep);
+		if (snap == NULL)
+			die("cannot take snapshot\n");
+		sink += snap->nents;
+	}
+}
+
+/*
+ * One op is folding a sample, taken roughly a second after the last one,
+ * into the rates.
+ */
+static void
+bench_update(void *arg, unsigned long n)
+{
+	ifinfo_t	*ifp = arg;
+	ifsample_t	sample = ifp->last;
+
+	while (n-- > 0) {
+		sample.stats.rxbytes += (n * 2654435761UL) % 10000000;
+		sample.stats.txbytes += (n * 40503UL) % 1000000;
+		sample.stats.rxpackets += n % 1000;
+		sample.stats.txpackets += n % 100;
+		sample.stamp += 1000000000ULL - 500000 + n % 1000000;
+		ifinfo_update(ifp, &sample);
+		sink += ifp->rate.rxbytes;
+	}
+}
+
+/*
+ * One op is a full sample's worth of smoothing: a new rate followed by
+ * the rest of the iterations.
+ */
+static void
+bench_nextbps(void *arg, unsigned long n)
+{
+	static double	*smoothtable;
+	ifinfo_t	*ifp = arg;
+	unsigned int	iter, niter = 10;
+
+	if (smoothtable == NULL &&
+	    (smoothtable = smoothtable_init(niter)) == NULL)
+		die("cannot create smoothing table\n");
+
+	while (n-- > 0) {
+		ifp->orate = ifp->rate;
+		ifp->rate.rxbytes = (n * 2654435761UL) % 10000000;
+		ifp->rate.txbytes = (n * 40503UL) % 1000000;
+		for (iter = 1; iter <= niter; iter++)
+			next_bps(smoothtable, iter, niter, ifp);
+		sink += ifp->bps;
+	}
+}
+
+/*
+ * Feed the graph rates that jump around by a few orders of magnitude, so
+ * that it has to rescale every so often.
+ */
+static void
+bench_graphadd(void *arg, unsigned long n)
+{
+	ifgraph_t	*graph = arg;
+	ifrates_t	rate;
+
+	(void) memset(&rate, 0, sizeof (rate));
+	while (n-- > 0) {
+		rate.rxbytes = ((n * 2654435761UL) >> (n % 16)) % 100000000;
+		rate.txbytes = rate.rxbytes / 8;
+		ifgraph_add(graph, &rate);
+		sink += graph->bps2bar;
+	}
+}
+
+static void
+bench_rescale(void *arg, unsigned long n)
+{
+	ifgraph_t *graph = arg;
+
+	while (n-- > 0) {
+		graph->bps2bar = WN_BENCH_BPS2BAR;
+		ifgraph_rescale(graph);
+		sink += graph->bps2bar;
+	}
+}
+
+static void
+bench_layout(void *arg, unsigned long n)
+{
+	bpslayout_t	layout;
+	ulonglong_t	bps;
+
+	while (n-- > 0) {
+		bps = (n * 2654435761ULL) >> (n % 32);
+		bps_layout(bps, &layout);
+		sink += layout.digits[WN_BPS_NDIGITS - 1] + layout.tens;
+	}
+}
+
+/*
+ * One op is a step to the next interface, wrapping around.
+ */
+static void
+bench_iflistnext(void *arg, unsigned long n)
+{
+	iflist_t	*iflp = arg;
+	char		ifname[IFNAMSIZ];
+
+	ifname[0] = '\0';
+	while (n-- > 0) {
+		if (!iflist_next(iflp, ifname[0] == '\0' ? NULL : ifname,
+		    ifname))
+			die("cannot enumerate interfaces\n");
+		sink += ifname[0];
+	}
+}
+
+/*
+ * One op is adding a sample, taken roughly a second after the last one,
+ * of a busy interface to a day's history.
+ */
+static void
+bench_histadd(void *arg, unsigned long n)
+{
+	ifhist_t	*hp = ifhist_create(86400);
+	ulonglong_t	stamp = 0, rx = 0, tx = 0;
+
+	while (n-- > 0) {
+		stamp += 1000000000ULL - 500000 + n % 1000000;
+		rx += (n * 2654435761UL) % 10000000;
+		tx += (n * 40503UL) % 1000000;
+		ifhist_add(hp, stamp, rx, tx);
+	}
+	ifhist_destroy(hp);
+}
+
+/*
+ * One op is decoding a sample of a day's history, as for export.
+ */
+static void
+bench_histnext(void *arg, unsigned long n)
+{
+	static ifhist_t	*hp;
+	ifhiter_t	iter;
+	ulonglong_t	stamp = 0, rx = 0, tx = 0;
+	unsigned long	i;
+
+	if (hp == NULL) {
+		hp = ifhist_create(86400);
+		for (i = 0; i < 86400; i++) {
+			stamp += 1000000000ULL - 500000 + i % 1000000;
+			rx += (i * 2654435761UL) % 10000000;
+			tx += (i * 40503UL) % 1000000;
+			ifhist_add(hp, stamp, rx, tx);
+		}
+	}
+
+	ifhist_iter(hp, &iter);
+	while (n-- > 0) {
+		if (!ifhist_next(&iter, &stamp, &rx, &tx))
+			ifhist_iter(hp, &iter);
+		sink += rx;
+	}
+}
+
+/*
+ * Write a trace of `nsamples' samples, a second apart, of a single
+ * interface "bench0" whose rates jump around by a few orders of
+ * magnitude, to `path'.
+ */
+static void
+trace_write(const char *path, unsigned long nsamples)
+{
+	ifrec_t		*recp;
+	ifstatsnap_t	snap = { NULL, 0, 0 };
+	ifstatent_t	*entp;
+	struct timeval	tv;
+	unsigned long	n, rate;
+
+	recp = ifrec_open(path);
+	if (recp == NULL)
+		die("cannot create trace %s\n", path);
+
+	entp = if_snapent(&snap, 0, "bench0", strlen("bench0"));
+	if (entp == NULL)
+		die("cannot allocate trace snapshot\n");
+	entp->ifindex = 1;
+	entp->flags = IFF_UP | IFF_RUNNING;
+	snap.nents = 1;
+
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	for (n = 0; n < nsamples; n++) {
+		rate = ((n * 2654435761UL) >> (n % 16)) % 100000000;
+		entp->stats.rxbytes += rate;
+		entp->stats.txbytes += rate / 8;
+		entp->stats.rxpackets += rate / 1000;
+		entp->stats.txpackets += rate / 8000;
+		tv.tv_sec++;
+		if (!ifrec_write(recp, &tv, &snap))
+			die("cannot write trace %s\n", path);
+	}
+
+	ifrec_close(recp);
+	if_snapfree(&snap);
+}
+
+#ifdef	WN_IFSTAT_LINUX
+/*
+ * Write a /proc/net/dev lookalike with `nif' interfaces into directory
+ * `dir', and return its (allocated) path.
+ */
+static char *
+procnetdev_fixture(const char *dir, unsigned int nif)
+{
+	FILE		*fp;
+	char		*path;
+	char		ifname[IFNAMSIZ];
+	unsigned int	i;
+
+	path = malloc(strlen(dir) + sizeof ("/dev."));
+	if (path == NULL)
+		die("cannot allocate fixture path\n");
+	(void) sprintf(path, "%s/dev", dir);
+
+	fp = fopen(path, "w");
+	if (fp == NULL)
+		die("cannot create fixture %s\n", path);
+
+	(void) fprintf(fp, "Inter-|   Receive                            "
+	    "                    |  Transmit\n"
+	    " face |bytes    packets errs drop fifo frame compressed "
+	    "multicast|bytes    packets errs drop fifo colls carrier "
+	    "compressed\n");
+
+	for (i = 0; i < nif; i++) {
+		(void) snprintf(ifname, IFNAMSIZ, "if%u", i);
+		(void) fprintf(fp, "%6s: %llu %u 0 0 0 0 0 %u %llu %u 0 0 0 "
+		    "0 0 0\n", ifname, 123456789ULL * (i + 1), 98765 + i, i % 7,
+		    987654321ULL * (i + 1), 56789 + i);
+	}
+	(void) fclose(fp);
+	return (path);
+}
+
+/*
+ * Number of interfaces in the table procnetdev_check() uses, and how
+ * often if_stats() is checked (it's linear in the table, so checking
+ * every interface would be quadratic).
+ */
+#define	WN_CHECK_NIFS	10000
+#define	WN_CHECK_STRIDE	97
+
+/*
+ * Return a random 64-bit counter, biased towards values that are short,
+ * near 32 bits, or long, since those are where a digit loop goes wrong.
+ */
+static unsigned long long
+check_ctr(void)
+{
+	unsigned long long val;
+
+	val = ((unsigned long long)random() << 33) ^
+	    ((unsigned long long)random() << 11) ^ random();
+
+	switch (random() % 4) {
+	case 0:
+		return (val % 1000);
+	case 1:
+		return (val & 0xffffffffULL);
+	case 2:
+		return (val >> (random() % 64));
+	}
+	return (val);
+}
+
+/*
+ * Write a /proc/net/dev lookalike with WN_CHECK_NIFS interfaces whose
+ * names, padding and counters are all random, then check that if_stats()
+ * and if_statsall() agree with procnetdev_refparse() on every field of
+ * every interface.  Return 1 if they do, 0 if not.
+ */
+static int
+procnetdev_check(void)
+{
+	static const char namechars[] =
+	    "abcdefghijklmnopqrstuvwxyz0123456789_.-";
+	char		dir[] = "/tmp/wnbenchXXXXXX";
+	char		path[sizeof (dir) + sizeof ("/dev")];
+	char		(*names)[IFNAMSIZ], (*refnames)[IFNAMSIZ];
+	char		*buf;
+	FILE		*fp;
+	long		len;
+	unsigned int	i, j, namelen, nbad = 0;
+	const ifstatsnap_t *snap;
+	ifstat_t	*statep;
+	ifstats_t	*wants, got;
+
+	srandom(getpid());
+
+	names = calloc(WN_CHECK_NIFS, IFNAMSIZ);
+	refnames = calloc(WN_CHECK_NIFS, IFNAMSIZ);
+	wants = calloc(WN_CHECK_NIFS, sizeof (ifstats_t));
+	if (names == NULL || refnames == NULL || wants == NULL ||
+	    mkdtemp(dir) == NULL)
+		die("cannot create fixture\n");
+	(void) sprintf(path, "%s/dev", dir);
+
+	fp = fopen(path, "w+");
+	if (fp == NULL)
+		die("cannot create fixture %s\n", path);
+
+	(void) fprintf(fp, "Inter-|   Receive                            "
+	    "                    |  Transmit\n"
+	    " face |bytes    packets errs drop fifo frame compressed "
+	    "multicast|bytes    packets errs drop fifo colls carrier "
+	    "compressed\n");
+
+	/*
+	 * The index suffix keeps the names unique; the rest is random.
+	 */
+	for (i = 0; i < WN_CHECK_NIFS; i++) {
+		namelen = random() % (IFNAMSIZ - 6);
+		for (j = 0; j < namelen; j++)
+			names[i][j] = namechars[random() %
+			    (sizeof (namechars) - 1)];
+		(void) sprintf(&names[i][namelen], "%u", i);
+
+		(void) fprintf(fp, "%*s:", (int)(random() % 8), names[i]);
+		for (j = 0; j < 16; j++)
+			(void) fprintf(fp, "%*s%llu", 1 + (int)(random() % 4),
+			    "", check_ctr());
+		(void) fputc('\n', fp);
+	}
+
+	/*
+	 * Keep a copy of the table for the reference parser.
+	 */
+	len = ftell(fp);
+	buf = malloc(len + 1);
+	if (len <= 0 || buf == NULL)
+		die("cannot read back fixture %s\n", path);
+	rewind(fp);
+	if (fread(buf, 1, len, fp) != (size_t)len)
+		die("cannot read back fixture %s\n", path);
+	buf[len] = '\0';
+	(void) fclose(fp);
+
+	if (setenv("WMNETLOAD_PROCNETDEV", path, 1) == -1)
+		die("cannot set fixture path\n");
+	statep = if_statinit(&ifstat_linux_ops);
+	if (statep == NULL)
+		die("cannot initialize fixture statistics\n");
+
+	if (procnetdev_refparse(buf, refnames, wants) != WN_CHECK_NIFS)
+		die("cannot parse fixture %s\n", path);
+
+	snap = if_statsall(statep);
+	if (snap == NULL || snap->nents != WN_CHECK_NIFS) {
+		warn("if_statsall() found %u of %u interfaces\n",
+		    snap == NULL ? 0 : snap->nents, WN_CHECK_NIFS);
+		nbad++;
+	}
+
+	for (i = 0; snap != NULL && i < snap->nents; i++) {
+		if (strcmp(snap->ents[i].name, names[i]) != 0 ||
+		    strcmp(refnames[i], names[i]) != 0 ||
+		    memcmp(&snap->ents[i].stats, &wants[i],
+		    sizeof (ifstats_t)) != 0) {
+			warn("if_statsall() disagrees on %s\n", names[i]);
+			nbad++;
+		}
+	}
+
+	for (i = 0; i < WN_CHECK_NIFS; i += WN_CHECK_STRIDE) {
+		if (!if_stats(names[i], statep, &got) ||
+		    memcmp(&got, &wants[i], sizeof (ifstats_t)) != 0) {
+			warn("if_stats() disagrees on %s\n", names[i]);
+			nbad++;
+		}
+	}
+
+	if_statfini(statep);
+	(void) unsetenv("WMNETLOAD_PROCNETDEV");
+	(void) unlink(path);
+	(void) rmdir(dir);
+	free(buf);
+	free(names);
+	free(refnames);
+	free(wants);
+
+	(void) printf("%s: /proc/net/dev parser: %u interfaces, %u "
+	    "mismatches\n", progname, WN_CHECK_NIFS, nbad);
+	return (nbad == 0);
+}
+
+/*
+ * Check that if_statsall() sees every interface in the real /proc/net/dev
+ * that a plain fgets() loop does, in the same order.  Unlike a fixture,
+ * procfs hands the table back a page or so per read, so this is what
+ * catches a reader that stops early.  The counters move between the two
+ * reads, so only the names are compared.  Return 1 if they agree (or
+ * there's no /proc/net/dev to check), 0 if not.
+ */
+static int
+procnetdev_livecheck(void)
+{
+	char		line[512];
+	char		*name, *colon;
+	FILE		*fp;
+	unsigned int	n = 0, nbad = 0;
+	const ifstatsnap_t *snap;
+	ifstat_t	*statep;
+
+	statep = if_statinit(&ifstat_linux_ops);
+	if (statep == NULL)
+		return (1);
+
+	snap = if_statsall(statep);
+	fp = fopen("/proc/net/dev", "r");
+	if (snap == NULL || fp == NULL)
+		die("cannot read /proc/net/dev");
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		colon = strchr(line, ':');
+		if (colon == NULL)
+			continue;
+		*colon = '\0';
+		name = line + strspn(line, " ");
+
+		if (n >= snap->nents || strcmp(snap->ents[n].name, name) != 0) {
+			warn("if_statsall() disagrees on %s\n", name);
+			nbad++;
+		}
+		n++;
+	}
+	(void) fclose(fp);
+
+	if (snap->nents != n) {
+		warn("if_statsall() found %u of %u interfaces\n", snap->nents,
+		    n);
+		nbad++;
+	}
+	if_statfini(statep);
+
+	(void) printf("%s: live /proc/net/dev: %u interfaces, %u "
+	    "mismatches\n", progname, n, nbad);
+	return (nbad == 0);
+}
+
+/*
+ * Parse the /proc/net/dev contents in `table' the way wmnetload always
+ * used to -- tokenize each line with strtok() and convert the columns
+ * with strtoull() -- storing the name of the i'th interface in `names[i]'
+ * and its statistics in `wants[i]'.  Return the number of interfaces.
+ */
+static unsigned int
+procnetdev_refparse(char *table, char (*names)[IFNAMSIZ], ifstats_t *wants)
+{
+	const char	*seps = " :\t|";
+	char		*line, *next, *token;
+	unsigned int	n, col;
+	unsigned long long *ctrs[16];
+
+	/*
+	 * Skip the two header lines; the column layout is the kernel's.
+	 */
+	line = strchr(strchr(table, '\n') + 1, '\n') + 1;
+	for (n = 0; *line != '\0'; line = next, n++) {
+		next = strchr(line, '\n');
+		*next++ = '\0';
+
+		(void) memset(&wants[n], 0, sizeof (ifstats_t));
+		(void) memset(ctrs, 0, sizeof (ctrs));
+		ctrs[0] = &wants[n].rxbytes;
+		ctrs[1] = &wants[n].rxpackets;
+		ctrs[2] = &wants[n].rxerrors;
+		ctrs[3] = &wants[n].rxdrops;
+		ctrs[4] = &wants[n].rxfifo;
+		ctrs[7] = &wants[n].multicast;
+		ctrs[8] = &wants[n].txbytes;
+		ctrs[9] = &wants[n].txpackets;
+		ctrs[10] = &wants[n].txerrors;
+		ctrs[11] = &wants[n].txdrops;
+		ctrs[12] = &wants[n].txfifo;
+
+		token = strtok(line, seps);
+		(void) strncpy(names[n], token, IFNAMSIZ - 1);
+		for (col = 0; col < 16; col++) {
+			token = strtok(NULL, seps);
+			if (token != NULL && ctrs[col] != NULL)
+				*ctrs[col] = strtoull(token, NULL, 10);
+		}
+	}
+
+	return (n);
+}
+#endif
+
+#ifdef	WN_IFSTAT_SYSFS
+/*
+ * The files sysfs_fixture() creates for each interface.
+ */
+static const char *sysfs_files[] = {
+	"statistics/rx_bytes", "statistics/tx_bytes",
+	"statistics/rx_packets", "statistics/tx_packets",
+	"statistics/rx_errors", "statistics/tx_errors",
+	"statistics/rx_dropped", "statistics/tx_dropped",
+	"statistics/rx_fifo_errors", "statistics/tx_fifo_errors",
+	"statistics/multicast", "flags", "ifindex"
+};
+
+#define	WN_BENCH_NSYSFS	(sizeof (sysfs_files) / sizeof (sysfs_files[0]))
+
+/*
+ * Write a /sys/class/net lookalike with `nif' interfaces, with the same
+ * counters as procnetdev_fixture(), into directory `dir', and return its
+ * (allocated) path.
+ */
+static char *
+sysfs_fixture(const char *dir, unsigned int nif)
+{
+	FILE		*fp;
+	char		*root;
+	char		path[PATH_MAX];
+	unsigned long long vals[WN_BENCH_NSYSFS];
+	unsigned int	i, j;
+
+	root = malloc(strlen(dir) + sizeof ("/net"));
+	if (root == NULL)
+		die("cannot allocate fixture path\n");
+	(void) sprintf(root, "%s/net", dir);
+	if (mkdir(root, 0700) == -1)
+		die("cannot create fixture %s\n", root);
+
+	for (i = 0; i < nif; i++) {
+		(void) memset(vals, 0, sizeof (vals));
+		vals[0] = 123456789ULL * (i + 1);
+		vals[1] = 987654321ULL * (i + 1);
+		vals[2] = 98765 + i;
+		vals[3] = 56789 + i;
+		vals[10] = i % 7;
+		vals[11] = IFF_UP | IFF_RUNNING;
+		vals[12] = i + 1;
+
+		(void) snprintf(path, sizeof (path), "%s/if%u", root, i);
+		if (mkdir(path, 0700) == -1)
+			die("cannot create fixture %s\n", path);
+		(void) snprintf(path, sizeof (path), "%s/if%u/statistics",
+		    root, i);
+		if (mkdir(path, 0700) == -1)
+			die("cannot create fixture %s\n", path);
+
+		for (j = 0; j < WN_BENCH_NSYSFS; j++) {
+			(void) snprintf(path, sizeof (path), "%s/if%u/%s", root,
+			    i, sysfs_files[j]);
+			fp = fopen(path, "w");
+			if (fp == NULL)
+				die("cannot create fixture %s\n", path);
+			(void) fprintf(fp, j == 11 ? "0x%llx\n" : "%llu\n",
+			    vals[j]);
+			(void) fclose(fp);
+		}
+	}
+	return (root);
+}
+
+/*
+ * Remove and free the `nif'-interface fixture tree at `root'.
+ */
+static void
+sysfs_unfixture(char *root, unsigned int nif)
+{
+	char		path[PATH_MAX];
+	unsigned int	i, j;
+
+	for (i = 0; i < nif; i++) {
+		for (j = 0; j < WN_BENCH_NSYSFS; j++) {
+			(void) snprintf(path, sizeof (path), "%s/if%u/%s", root,
+			    i, sysfs_files[j]);
+			(void) unlink(path);
+		}
+		(void) snprintf(path, sizeof (path), "%s/if%u/statistics",
+		    root, i);
+		(void) rmdir(path);
+		(void) snprintf(path, sizeof (path), "%s/if%u", root, i);
+		(void) rmdir(path);
+	}
+	(void) rmdir(root);
+	free(root);
+}
+#endif
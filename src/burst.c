@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * The microburst sampler.  The sampler thread is the only writer of the
+ * ring's head and the display the only writer of its tail, so the two
+ * never need a lock: each publishes its index with a release store after
+ * it's done with the slots, and reads the other's with an acquire load.
+ * If the display falls behind (say, the X server is stuck), the sampler
+ * drops samples rather than wait for it.
+ */
+
+#pragma ident "@(#)burst.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef	WN_BURST
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include "burst.h"
+#include "sched.h"
+#include "utils.h"
+
+#ifdef	WN_BURST
+
+#define	WN_BURST_MINSLOTS	16	/* smallest ring */
+#define	WN_BURST_LINESIZE	64	/* keeps the indices apart in cache */
+
+#define	WN_LOAD_ACQUIRE(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define	WN_STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define	WN_LOAD_RELAXED(p)	__atomic_load_n((p), __ATOMIC_RELAXED)
+#define	WN_ADD_RELAXED(p, v)	__atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+
+typedef struct {
+	ulonglong_t	stamp;		/* if_statstamp() of the sample */
+	ulonglong_t	rxbytes;	/* bytes received */
+	ulonglong_t	txbytes;	/* bytes sent */
+} bsample_t;
+
+struct burst {
+	/*
+	 * Set up by burst_create(), and only read after that.
+	 */
+	ifstat_t	*statep;	/* the sampler's own statistics state */
+	char		*ifname;	/* interface being sampled */
+	unsigned int	msec;		/* sampling period */
+	bsample_t	*ring;		/* the ring itself */
+	unsigned int	mask;		/* number of slots in `ring', less 1 */
+	pthread_t	thread;		/* the sampler thread */
+
+	/*
+	 * Written by the sampler thread.
+	 */
+	char		pad0[WN_BURST_LINESIZE];
+	unsigned int	head;		/* next slot to fill */
+	unsigned long	sampled;	/* samples taken */
+	unsigned long	dropped;	/* samples dropped; the ring was full */
+
+	/*
+	 * Written by the display.
+	 */
+	char		pad1[WN_BURST_LINESIZE];
+	unsigned int	tail;		/* next slot to take */
+	int		stop;		/* sampler thread should exit */
+	bsample_t	last;		/* last sample taken */
+};
+
+static void	*burst_run(void *);
+static void	burst_sample(burst_t *);
+
+/*
+ * Start sampling interface `ifname' every `msec' milliseconds, through a
+ * statistics state of its own opened with `ops', in a thread of its own.
+ * The ring holds enough samples to cover twice `span' milliseconds, the
+ * longest the display will go without emptying it.  Return
+ * NULL on failure.
+ */
+burst_t *
+burst_create(const ifstatops_t *ops, const char *ifname, unsigned int msec,
+    unsigned int span)
+{
+	burst_t		*bp;
+	sigset_t	all, old;
+	unsigned int	nslots;
+	int		error;
+
+	bp = calloc(1, sizeof (burst_t));
+	if (bp == NULL) {
+		warn("cannot allocate microburst sampler");
+		return (NULL);
+	}
+
+	nslots = WN_BURST_MINSLOTS;
+	while (nslots < 2 * (span / msec) + 2)
+		nslots *= 2;
+
+	bp->msec = msec;
+	bp->mask = nslots - 1;
+	bp->ring = calloc(nslots, sizeof (bsample_t));
+	bp->ifname = strdup(ifname);
+	if (bp->ring == NULL || bp->ifname == NULL) {
+		warn("cannot allocate microburst sampler");
+		goto fail;
+	}
+
+	bp->statep = if_statinit(ops);
+	if (bp->statep == NULL)
+		goto fail;
+
+	/*
+	 * Signals are for the display to handle, so keep them all away
+	 * from the sampler thread.
+	 */
+	(void) sigfillset(&all);
+	(void) pthread_sigmask(SIG_SETMASK, &all, &old);
+	error = pthread_create(&bp->thread, NULL, burst_run, bp);
+	(void) pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (error != 0) {
+		errno = error;
+		warn("cannot start microburst sampler thread");
+		if_statfini(bp->statep);
+		goto fail;
+	}
+
+	return (bp);
+fail:
+	free(bp->ring);
+	free(bp->ifname);
+	free(bp);
+	return (NULL);
+}
+
+/*
+ * Stop the sampler pointed to by `bp', and destroy it.
+ */
+void
+burst_destroy(burst_t *bp)
+{
+	WN_STORE_RELEASE(&bp->stop, 1);
+	(void) pthread_join(bp->thread, NULL);
+
+	if_statfini(bp->statep);
+	free(bp->ring);
+	free(bp->ifname);
+	free(bp);
+}
+
+/*
+ * Take the next sample from the sampler pointed to by `bp', and store the
+ * rates received and sent (in bytes per second) between it and the one
+ * before in `rxp' and `txp'.  Return 1 on success, or 0 if there are no
+ * more samples yet.
+ */
+int
+burst_next(burst_t *bp, double *rxp, double *txp)
+{
+	bsample_t	*sp, last;
+	double		persec;
+
+	while (bp->tail != WN_LOAD_ACQUIRE(&bp->head)) {
+		sp = &bp->ring[bp->tail & bp->mask];
+		last = bp->last;
+		bp->last = *sp;
+		WN_STORE_RELEASE(&bp->tail, bp->tail + 1);
+
+		/*
+		 * A byte count that went backwards was reset (or wrapped);
+		 * just start over from the new one.
+		 */
+		if (last.stamp == 0 || bp->last.stamp <= last.stamp ||
+		    bp->last.rxbytes < last.rxbytes ||
+		    bp->last.txbytes < last.txbytes)
+			continue;
+
+		persec = 1e9 / (double)(bp->last.stamp - last.stamp);
+		*rxp = (double)(bp->last.rxbytes - last.rxbytes) * persec;
+		*txp = (double)(bp->last.txbytes - last.txbytes) * persec;
+		return (1);
+	}
+
+	return (0);
+}
+
+/*
+ * Store the number of samples the sampler pointed to by `bp' has taken in
+ * `sampledp', and the number of those it had to drop in `droppedp'.
+ */
+void
+burst_counts(burst_t *bp, unsigned long *sampledp, unsigned long *droppedp)
+{
+	*sampledp = WN_LOAD_RELAXED(&bp->sampled);
+	*droppedp = WN_LOAD_RELAXED(&bp->dropped);
+}
+
+/*
+ * The sampler thread: sample the interface on a schedule of its own until
+ * told to stop.
+ */
+static void *
+burst_run(void *arg)
+{
+	burst_t	*bp = arg;
+	sched_t	*schedp;
+
+	schedp = sched_create(bp->msec);
+	while (!WN_LOAD_ACQUIRE(&bp->stop)) {
+		burst_sample(bp);
+		sched_arm(schedp, bp->msec);
+		(void) sched_wait(schedp);
+		(void) sched_next(schedp);
+	}
+	sched_destroy(schedp);
+	return (NULL);
+}
+
+/*
+ * Take a sample for the sampler pointed to by `bp', and put it in the
+ * ring if there's room.
+ */
+static void
+burst_sample(burst_t *bp)
+{
+	ifstats_t	stats;
+	bsample_t	*sp;
+	unsigned int	head = bp->head;
+
+	if (!if_stats(bp->ifname, bp->statep, &stats))
+		return;
+
+	(void) WN_ADD_RELAXED(&bp->sampled, 1);
+	if (head - WN_LOAD_ACQUIRE(&bp->tail) > bp->mask) {
+		(void) WN_ADD_RELAXED(&bp->dropped, 1);
+		return;
+	}
+
+	sp = &bp->ring[head & bp->mask];
+	sp->stamp = if_statstamp(bp->statep);
+	sp->rxbytes = stats.rxbytes;
+	sp->txbytes = stats.txbytes;
+	WN_STORE_RELEASE(&bp->head, head + 1);
+}
+
+#else	/* WN_BURST */
+
+/*
+ * Without threads (or the atomic operations the ring needs), there's no
+ * microburst sampling.
+ */
+/* ARGSUSED */
+burst_t *
+burst_create(const ifstatops_t *ops, const char *ifname, unsigned int msec,
+    unsigned int span)
+{
+	warn("microburst sampling is not supported on this system\n");
+	return (NULL);
+}
+
+/* ARGSUSED */
+void
+burst_destroy(burst_t *bp)
+{
+}
+
+/* ARGSUSED */
+int
+burst_next(burst_t *bp, double *rxp, double *txp)
+{
+	return (0);
+}
+
+/* ARGSUSED */
+void
+burst_counts(burst_t *bp, unsigned long *sampledp, unsigned long *droppedp)
+{
+	*sampledp = *droppedp = 0;
+}
+
+#endif	/* WN_BURST */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Microburst sampling interfaces.  A sampler thread reads an interface's
+ * byte counters every few milliseconds and hands the samples to the
+ * display through a lock-free ring, from which the display takes the rates
+ * between them once per graph column.
+ */
+
+#ifndef	WN_BURST_H
+#define	WN_BURST_H
+
+#pragma ident "@(#)burst.h	1.1	26/10/17 meem"
+
+#include "ifstat.h"
+
+#define	WN_BURST_MINMS	1	/* shortest sampling period, in milliseconds */
+
+typedef struct burst burst_t;
+
+extern burst_t		*burst_create(const ifstatops_t *, const char *,
+			    unsigned int, unsigned int);
+extern void		burst_destroy(burst_t *);
+extern int		burst_next(burst_t *, double *, double *);
+extern void		burst_counts(burst_t *, unsigned long *,
+			    unsigned long *);
+
+#endif /* WN_BURST_H */
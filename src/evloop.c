@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * The event loop.  Where there's epoll, the descriptors are registered
+ * with the kernel once, and each wait costs the same however many there
+ * are; elsewhere (or if epoll doesn't work), the same interface is
+ * provided on top of poll().
+ */
+
+#pragma ident "@(#)evloop.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef	HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#include "evloop.h"
+#include "utils.h"
+
+#define	WN_EVLOOP_MAXREADY	8	/* most sources ready per wait */
+
+typedef struct {
+	int		fd;		/* descriptor */
+	int		token;		/* token to return when it's ready */
+} evsrc_t;
+
+struct evloop {
+	int		epfd;		/* epoll descriptor, or -1 */
+	evsrc_t		*srcs;		/* registered sources */
+	struct pollfd	*pfds;		/* poll() array, parallel to `srcs' */
+	unsigned int	nsrcs;		/* number of registered sources */
+	evsrc_t		ready[WN_EVLOOP_MAXREADY]; /* ready, not returned */
+	unsigned int	nready;		/* number of entries in `ready' */
+	unsigned int	next;		/* next entry in `ready' to return */
+	unsigned long	nwakeups;	/* times we've waited in the kernel */
+};
+
+static void	evloop_epoll(evloop_t *, int);
+static void	evloop_poll(evloop_t *, int);
+static void	evloop_ready(evloop_t *, int, int);
+static void	evloop_remove(evloop_t *, unsigned int);
+
+/*
+ * Create an event loop with nothing registered.  If it returns, the
+ * pointer returned is guaranteed to be valid.
+ */
+evloop_t *
+evloop_create(void)
+{
+	evloop_t *evp;
+
+	evp = calloc(1, sizeof (evloop_t));
+	if (evp == NULL)
+		die("cannot allocate event loop");
+
+	evp->epfd = -1;
+#ifdef	HAVE_SYS_EPOLL_H
+	evp->epfd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+	return (evp);
+}
+
+/*
+ * Destroy the event loop pointed to by `evp'.  The registered descriptors
+ * are left open.
+ */
+void
+evloop_destroy(evloop_t *evp)
+{
+	if (evp->epfd != -1)
+		(void) close(evp->epfd);
+
+	free(evp->srcs);
+	free(evp->pfds);
+	free(evp);
+}
+
+/*
+ * Register descriptor `fd' with the event loop pointed to by `evp', such
+ * that evloop_wait() returns `token' (which must not be negative) when it
+ * becomes readable.
+ */
+void
+evloop_add(evloop_t *evp, int fd, int token)
+{
+	evsrc_t		*srcs;
+	struct pollfd	*pfds;
+#ifdef	HAVE_SYS_EPOLL_H
+	struct epoll_event ev;
+#endif
+
+	srcs = realloc(evp->srcs, (evp->nsrcs + 1) * sizeof (evsrc_t));
+	if (srcs == NULL)
+		die("cannot grow event loop");
+	evp->srcs = srcs;
+
+	pfds = realloc(evp->pfds, (evp->nsrcs + 1) * sizeof (struct pollfd));
+	if (pfds == NULL)
+		die("cannot grow event loop");
+	evp->pfds = pfds;
+
+#ifdef	HAVE_SYS_EPOLL_H
+	/*
+	 * The kernel hands back both the descriptor and its token, so
+	 * there's nothing to look up when it's ready.
+	 */
+	if (evp->epfd != -1) {
+		(void) memset(&ev, 0, sizeof (ev));
+		ev.events = EPOLLIN;
+		ev.data.u64 = (unsigned long long)token << 32 |
+		    (unsigned int)fd;
+		if (epoll_ctl(evp->epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+			die("cannot watch descriptor %d", fd);
+	}
+#endif
+	srcs[evp->nsrcs].fd = fd;
+	srcs[evp->nsrcs].token = token;
+	pfds[evp->nsrcs].fd = fd;
+	pfds[evp->nsrcs].events = POLLIN;
+	pfds[evp->nsrcs].revents = 0;
+	evp->nsrcs++;
+}
+
+/*
+ * Stop watching descriptor `fd' in the event loop pointed to by `evp'.
+ * This must be done before `fd' is closed.
+ */
+void
+evloop_del(evloop_t *evp, int fd)
+{
+	unsigned int i;
+
+	for (i = 0; i < evp->nsrcs; i++) {
+		if (evp->srcs[i].fd == fd) {
+#ifdef	HAVE_SYS_EPOLL_H
+			if (evp->epfd != -1)
+				(void) epoll_ctl(evp->epfd, EPOLL_CTL_DEL, fd,
+				    NULL);
+#endif
+			evloop_remove(evp, i);
+			return;
+		}
+	}
+}
+
+/*
+ * Wait up to `msec' milliseconds (or forever, if it's -1) for one of the
+ * descriptors registered with `evp' to become readable, and return its
+ * token.  Return WN_EVLOOP_NONE if none did, or if a signal arrived
+ * first.  Descriptors found ready together are handed back one per call
+ * without waiting again, so a burst of activity costs a single wakeup.
+ */
+int
+evloop_wait(evloop_t *evp, int msec)
+{
+	if (evp->next == evp->nready) {
+		evp->nready = evp->next = 0;
+		evp->nwakeups++;
+		if (evp->epfd != -1)
+			evloop_epoll(evp, msec);
+		else
+			evloop_poll(evp, msec);
+
+		if (evp->nready == 0)
+			return (WN_EVLOOP_NONE);
+	}
+	return (evp->ready[evp->next++].token);
+}
+
+/*
+ * Return the number of times the event loop pointed to by `evp' has had
+ * to wait in the kernel (and so has woken the process up).
+ */
+unsigned long
+evloop_wakeups(evloop_t *evp)
+{
+	return (evp->nwakeups);
+}
+
+/*
+ * Wait up to `msec' milliseconds for the descriptors registered with the
+ * epoll descriptor of `evp', and note the ones that are ready.
+ */
+/* ARGSUSED */
+static void
+evloop_epoll(evloop_t *evp, int msec)
+{
+#ifdef	HAVE_SYS_EPOLL_H
+	struct epoll_event	evs[WN_EVLOOP_MAXREADY];
+	int			i, n;
+
+	n = epoll_wait(evp->epfd, evs, WN_EVLOOP_MAXREADY, msec);
+	for (i = 0; i < n; i++) {
+		evloop_ready(evp, (int)(evs[i].data.u64 & 0xffffffff),
+		    (int)(evs[i].data.u64 >> 32));
+	}
+#endif
+}
+
+/*
+ * Wait up to `msec' milliseconds for the descriptors registered with
+ * `evp' using poll(), and note the ones that are ready.
+ */
+static void
+evloop_poll(evloop_t *evp, int msec)
+{
+	unsigned int i;
+
+	if (poll(evp->pfds, evp->nsrcs, msec) <= 0)
+		return;
+
+	/*
+	 * A descriptor that was closed without being deregistered (which
+	 * epoll would have forgotten about by itself) is just dropped.
+	 */
+	for (i = evp->nsrcs; i-- > 0; ) {
+		if (evp->pfds[i].revents & POLLNVAL)
+			evloop_remove(evp, i);
+		else if (evp->pfds[i].revents != 0)
+			evloop_ready(evp, evp->srcs[i].fd, evp->srcs[i].token);
+	}
+}
+
+/*
+ * Note that descriptor `fd', registered with `token', is ready.
+ */
+static void
+evloop_ready(evloop_t *evp, int fd, int token)
+{
+	if (evp->nready < WN_EVLOOP_MAXREADY) {
+		evp->ready[evp->nready].fd = fd;
+		evp->ready[evp->nready].token = token;
+		evp->nready++;
+	}
+}
+
+/*
+ * Remove source `i' from `evp', along with any readiness noted for it
+ * that hasn't been handed back yet.
+ */
+static void
+evloop_remove(evloop_t *evp, unsigned int i)
+{
+	unsigned int	j, k;
+	int		fd = evp->srcs[i].fd;
+
+	evp->nsrcs--;
+	evp->srcs[i] = evp->srcs[evp->nsrcs];
+	evp->pfds[i] = evp->pfds[evp->nsrcs];
+
+	for (j = k = evp->next; j < evp->nready; j++) {
+		if (evp->ready[j].fd != fd)
+			evp->ready[k++] = evp->ready[j];
+	}
+	evp->nready = k;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Event loop interfaces.  Any number of descriptors can be registered,
+ * each with a token; waiting returns the token of a descriptor that is
+ * ready, so that callers can treat every source -- the X connection,
+ * timers, kernel notifications -- the same way.
+ */
+
+#ifndef	WN_EVLOOP_H
+#define	WN_EVLOOP_H
+
+#pragma ident "@(#)evloop.h	1.1	26/10/17 meem"
+
+#define	WN_EVLOOP_NONE	(-1)	/* evloop_wait() found nothing ready */
+
+typedef struct evloop evloop_t;
+
+extern evloop_t		*evloop_create(void);
+extern void		evloop_destroy(evloop_t *);
+extern void		evloop_add(evloop_t *, int, int);
+extern void		evloop_del(evloop_t *, int);
+extern int		evloop_wait(evloop_t *, int);
+extern unsigned long	evloop_wakeups(evloop_t *);
+
+#endif /* WN_EVLOOP_H */
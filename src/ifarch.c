@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface history archive routines.  See ifarch.h for the layout.
+ */
+
+#pragma ident "@(#)ifarch.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ifarch.h"
+#include "utils.h"
+
+#define	WN_NSPERMSEC	1000000ULL
+
+struct ifarch {
+	ifahdr_t	*hdrp;		/* start of the mapping */
+	ifarow_t	*rows[WN_IFARCH_NTIERS]; /* each tier's first row */
+	size_t		size;		/* size of the mapping */
+	int		fd;		/* the archive itself */
+};
+
+/*
+ * The tiers new archives are laid out with: a second for an hour, a
+ * minute for a day, and an hour for 31 days.
+ */
+static const ifatier_t ifa_tiers[WN_IFARCH_NTIERS] = {
+	{ 1, 3600 }, { 60, 1440 }, { 3600, 744 }
+};
+
+static size_t	ifa_size(const ifahdr_t *);
+static int	ifa_valid(const ifahdr_t *, size_t);
+
+/*
+ * Open the archive at `path' for the interface named `ifname', creating
+ * it as needed, and locking it so that only one process updates it at a
+ * time.  An existing file that isn't an archive of `ifname' with our
+ * layout is left alone, since it may well be something the user wants.
+ * If `ifname' is NULL, an existing archive is opened just for reading
+ * instead.  Return a handle for it, or NULL on failure.
+ */
+ifarch_t *
+ifarch_open(const char *path, const char *ifname)
+{
+	ifarch_t	*archp;
+	ifahdr_t	hdr;
+	struct stat	st;
+	struct flock	lock;
+	unsigned int	i;
+	size_t		off;
+	int		prot = PROT_READ;
+
+	archp = calloc(1, sizeof (ifarch_t));
+	if (archp == NULL) {
+		warn("cannot allocate archive state");
+		return (NULL);
+	}
+
+	if (ifname != NULL) {
+		prot |= PROT_WRITE;
+		archp->fd = open(path, O_RDWR|O_CREAT, 0644);
+	} else {
+		archp->fd = open(path, O_RDONLY);
+	}
+	if (archp->fd == -1) {
+		warn("cannot open archive %s", path);
+		goto fail;
+	}
+
+	if (ifname != NULL) {
+		(void) memset(&lock, 0, sizeof (lock));
+		lock.l_type = F_WRLCK;
+		lock.l_whence = SEEK_SET;
+		if (fcntl(archp->fd, F_SETLK, &lock) == -1) {
+			warn("archive %s is in use", path);
+			goto fail;
+		}
+	}
+
+	if (fstat(archp->fd, &st) == -1) {
+		warn("cannot stat archive %s", path);
+		goto fail;
+	}
+
+	/*
+	 * Only a file we just created (or an empty one) is set up afresh;
+	 * anything else has to be an archive of `ifname' with our layout.
+	 */
+	(void) memset(&hdr, 0, sizeof (hdr));
+	if ((size_t)st.st_size >= sizeof (hdr) &&
+	    pread(archp->fd, &hdr, sizeof (hdr), 0) != sizeof (hdr)) {
+		warn("cannot read archive %s", path);
+		goto fail;
+	}
+
+	if (ifname == NULL) {
+		if (!ifa_valid(&hdr, st.st_size)) {
+			warn("%s is not an interface archive\n", path);
+			goto fail;
+		}
+	} else if (st.st_size != 0) {
+		if (!ifa_valid(&hdr, st.st_size) ||
+		    strncmp(hdr.ifname, ifname, IFNAMSIZ) != 0 ||
+		    memcmp(hdr.tiers, ifa_tiers, sizeof (ifa_tiers)) != 0) {
+			warn("%s is not an archive of %s with this layout; "
+			    "not archiving\n", path, ifname);
+			goto fail;
+		}
+	} else {
+		(void) memcpy(hdr.magic, WN_IFARCH_MAGIC, WN_IFARCH_MAGICLEN);
+		hdr.version = WN_IFARCH_VERSION;
+		(void) strncpy(hdr.ifname, ifname, IFNAMSIZ - 1);
+		hdr.ntiers = WN_IFARCH_NTIERS;
+		hdr.rowsize = sizeof (ifarow_t);
+		(void) memcpy(hdr.tiers, ifa_tiers, sizeof (ifa_tiers));
+
+		if (ftruncate(archp->fd, ifa_size(&hdr)) == -1 ||
+		    pwrite(archp->fd, &hdr, sizeof (hdr), 0) != sizeof (hdr)) {
+			warn("cannot initialize archive %s", path);
+			goto fail;
+		}
+	}
+
+	archp->size = ifa_size(&hdr);
+	archp->hdrp = mmap(NULL, archp->size, prot, MAP_SHARED, archp->fd, 0);
+	if (archp->hdrp == MAP_FAILED) {
+		warn("cannot map archive %s", path);
+		goto fail;
+	}
+
+	off = sizeof (ifahdr_t);
+	for (i = 0; i < WN_IFARCH_NTIERS; i++) {
+		archp->rows[i] = (ifarow_t *)((char *)archp->hdrp + off);
+		off += archp->hdrp->tiers[i].nrows * sizeof (ifarow_t);
+	}
+	return (archp);
+fail:
+	if (archp->fd != -1)
+		(void) close(archp->fd);
+	free(archp);
+	return (NULL);
+}
+
+/*
+ * Add a sample to the archive associated with `archp': `elapsed'
+ * nanoseconds at the per-second rates `ratep', ending during second
+ * `now'.  A sample can span several rows of a tier (say, while -ad is
+ * idling), so its bytes and time are spread over the rows it covers in
+ * proportion to how much of each it covers, and each of them gets its
+ * rate as a peak; no more than a lap's worth of rows is touched.  Rows
+ * left over from an earlier lap are started over first.  Nothing is
+ * synced -- if the machine goes down, the kernel may not have written
+ * back the last few rows.
+ */
+void
+ifarch_update(ifarch_t *archp, time_t now, ulonglong_t elapsed,
+    const ifrates_t *ratep)
+{
+	const ifatier_t	*tierp;
+	ifarow_t	*rowp;
+	double		secs = (double)elapsed / (WN_NSPERMSEC * 1000);
+	double		rxbytes = ratep->rxbytes * secs;
+	double		txbytes = ratep->txbytes * secs;
+	ulonglong_t	msecs = elapsed / WN_NSPERMSEC;
+	ulonglong_t	end = ((ulonglong_t)now + 1) * 1000;
+	ulonglong_t	begin, lap, start, from, to, rxdone, txdone, val;
+	unsigned int	i;
+
+	if (msecs == 0)
+		msecs = 1;
+	begin = (msecs < end) ? end - msecs : 0;
+
+	for (i = 0; i < WN_IFARCH_NTIERS; i++) {
+		tierp = &archp->hdrp->tiers[i];
+		lap = (ulonglong_t)tierp->step * tierp->nrows * 1000;
+		from = (end - begin > lap) ? end - lap : begin;
+
+		/*
+		 * Work out each row's share from the running totals, so that
+		 * rounding doesn't lose or make up any bytes.
+		 */
+		rxdone = rxbytes * (from - begin) / msecs + 0.5;
+		txdone = txbytes * (from - begin) / msecs + 0.5;
+		for (start = from / 1000 - from / 1000 % tierp->step;
+		    start * 1000 < end; start += tierp->step, from = to) {
+			rowp = &archp->rows[i][start / tierp->step %
+			    tierp->nrows];
+			if (rowp->stamp != start) {
+				(void) memset(rowp, 0, sizeof (ifarow_t));
+				rowp->stamp = start;
+			}
+
+			to = (start + tierp->step) * 1000;
+			if (to > end)
+				to = end;
+
+			val = rxbytes * (to - begin) / msecs + 0.5;
+			rowp->rxbytes += val - rxdone;
+			rxdone = val;
+			val = txbytes * (to - begin) / msecs + 0.5;
+			rowp->txbytes += val - txdone;
+			txdone = val;
+			rowp->msecs += to - from;
+
+			if (ratep->rxbytes > rowp->rxpeak)
+				rowp->rxpeak = ratep->rxbytes;
+			if (ratep->txbytes > rowp->txpeak)
+				rowp->txpeak = ratep->txbytes;
+		}
+	}
+}
+
+/*
+ * Return the header of the archive associated with `archp'.
+ */
+const ifahdr_t *
+ifarch_header(const ifarch_t *archp)
+{
+	return (archp->hdrp);
+}
+
+/*
+ * Return the row of tier `tier' of the archive associated with `archp'
+ * that covers time `when', or NULL if there isn't one (it's too long ago,
+ * or nothing was sampled then).
+ */
+const ifarow_t *
+ifarch_row(const ifarch_t *archp, unsigned int tier, time_t when)
+{
+	const ifatier_t	*tierp = &archp->hdrp->tiers[tier];
+	const ifarow_t	*rowp;
+
+	rowp = &archp->rows[tier][when / tierp->step % tierp->nrows];
+	if (rowp->stamp != (ulonglong_t)(when - when % tierp->step))
+		return (NULL);
+
+	return (rowp);
+}
+
+/*
+ * Close the archive associated with `archp' and free its state.
+ */
+void
+ifarch_close(ifarch_t *archp)
+{
+	(void) munmap((void *)archp->hdrp, archp->size);
+	(void) close(archp->fd);
+	free(archp);
+}
+
+/*
+ * Return the size of an archive with the header pointed to by `hdrp'.
+ */
+static size_t
+ifa_size(const ifahdr_t *hdrp)
+{
+	size_t		size = sizeof (ifahdr_t);
+	unsigned int	i;
+
+	for (i = 0; i < WN_IFARCH_NTIERS; i++)
+		size += hdrp->tiers[i].nrows * sizeof (ifarow_t);
+
+	return (size);
+}
+
+/*
+ * Check whether the header pointed to by `hdrp' belongs to an archive of
+ * a version and size we understand, `size' bytes long.
+ */
+static int
+ifa_valid(const ifahdr_t *hdrp, size_t size)
+{
+	unsigned int i;
+
+	if (memcmp(hdrp->magic, WN_IFARCH_MAGIC, WN_IFARCH_MAGICLEN) != 0 ||
+	    hdrp->version != WN_IFARCH_VERSION ||
+	    hdrp->ntiers != WN_IFARCH_NTIERS ||
+	    hdrp->rowsize != sizeof (ifarow_t) ||
+	    memchr(hdrp->ifname, '\0', IFNAMSIZ) == NULL)
+		return (0);
+
+	for (i = 0; i < WN_IFARCH_NTIERS; i++) {
+		if (hdrp->tiers[i].step == 0 || hdrp->tiers[i].nrows == 0)
+			return (0);
+	}
+
+	return (size == ifa_size(hdrp));
+}
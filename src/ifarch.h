@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface history archives.  An archive is a fixed-size file holding
+ * an interface's history at several resolutions (tiers), each one a
+ * round-robin of rows: by default, one row a second for an hour, one a
+ * minute for a day, and one an hour for a month.  It's mmap()ed shared
+ * and updated in place, so keeping it costs a few stores per sample and
+ * it survives the process; the kernel writes it back in its own time.
+ *
+ * The file is an ifahdr_t followed by each tier's rows in turn.  A row
+ * lives at a fixed spot -- its start time divided by its tier's step,
+ * modulo the tier's row count -- so a row whose stamp isn't the start of
+ * the step it's read for is left over from an earlier lap, and holds
+ * nothing for that step.  Everything is stored in host byte order; an
+ * archive isn't meant to move between machines.
+ */
+
+#ifndef	WN_IFARCH_H
+#define	WN_IFARCH_H
+
+#pragma ident "@(#)ifarch.h	1.1	26/10/17 meem"
+
+#include <sys/types.h>
+#include <net/if.h>
+#include <time.h>
+
+#include "ifstat.h"
+
+#define	WN_IFARCH_MAGIC		"WNRA"
+#define	WN_IFARCH_MAGICLEN	4
+#define	WN_IFARCH_VERSION	1
+#define	WN_IFARCH_NTIERS	3
+
+typedef struct {
+	unsigned int	step;		/* seconds covered by each row */
+	unsigned int	nrows;		/* rows in the tier */
+} ifatier_t;
+
+typedef struct {
+	char		magic[WN_IFARCH_MAGICLEN]; /* WN_IFARCH_MAGIC */
+	unsigned int	version;	/* WN_IFARCH_VERSION */
+	char		ifname[IFNAMSIZ]; /* interface archived */
+	unsigned int	ntiers;		/* WN_IFARCH_NTIERS */
+	unsigned int	rowsize;	/* sizeof (ifarow_t) */
+	ifatier_t	tiers[WN_IFARCH_NTIERS]; /* finest first */
+} ifahdr_t;
+
+typedef struct {
+	ulonglong_t	stamp;		/* start of the step, or 0 if unused */
+	ulonglong_t	rxbytes;	/* bytes received during the step */
+	ulonglong_t	txbytes;	/* bytes sent during the step */
+	unsigned int	msecs;		/* milliseconds of it sampled */
+	float		rxpeak;		/* highest receive rate sampled */
+	float		txpeak;		/* highest transmit rate sampled */
+	unsigned int	pad;
+} ifarow_t;
+
+typedef struct ifarch ifarch_t;
+
+extern ifarch_t		*ifarch_open(const char *, const char *);
+extern void		ifarch_update(ifarch_t *, time_t, ulonglong_t,
+			    const ifrates_t *);
+extern const ifahdr_t	*ifarch_header(const ifarch_t *);
+extern const ifarow_t	*ifarch_row(const ifarch_t *, unsigned int,
+			    time_t);
+extern void		ifarch_close(ifarch_t *);
+
+#endif /* WN_IFARCH_H */
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Graph and meter arithmetic.  Nothing in here may know about X, so that
+ * it can be timed (and reasoned about) on its own.
+ */
+
+#pragma ident "@(#)ifgraph.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ifgraph.h"
+#include "utils.h"
+
+static double	ifgraph_value(const ifgraph_t *, const ifgcol_t *);
+static void	ifgraph_bars(const ifgraph_t *, ifgcol_t *);
+static unsigned char ifgraph_bar(const ifgraph_t *, double);
+
+/*
+ * Create a graph with `ncols' columns, each `height' pixels tall, with
+ * each pixel initially (and at least) `bps2bar' bytes per second, scaled
+ * to fit what `scale' says.  If it returns, the pointer returned is
+ * guaranteed to be valid.
+ */
+ifgraph_t *
+ifgraph_create(unsigned int ncols, unsigned int height, ulonglong_t bps2bar,
+    ifgscale_t scale)
+{
+	ifgraph_t *graph;
+
+	if (height > UCHAR_MAX)
+		die("interface statistics graph is too tall\n");
+
+	graph = calloc(1, sizeof (ifgraph_t));
+	if (graph == NULL)
+		die("cannot allocate interface statistics graph");
+
+	graph->cols = calloc(ncols, sizeof (ifgcol_t));
+	if (graph->cols == NULL)
+		die("cannot allocate interface statistics graph");
+
+	graph->ncols = ncols;
+	graph->height = height;
+	graph->scale = scale;
+	graph->bps2bar = bps2bar;
+	graph->minbps2bar = bps2bar;
+	return (graph);
+}
+
+/*
+ * Destroy the graph pointed to by `graph'.
+ */
+void
+ifgraph_destroy(ifgraph_t *graph)
+{
+	free(graph->cols);
+	free(graph);
+}
+
+/*
+ * Note that `rx' bytes per second were received and `tx' sent at some
+ * point during the column `graph' is about to get.
+ */
+void
+ifgraph_sample(ifgraph_t *graph, double rx, double tx)
+{
+	ifgcol_t *np = &graph->next;
+
+	if (np->count++ == 0) {
+		np->rxmin = np->rxmax = rx;
+		np->txmin = np->txmax = tx;
+		return;
+	}
+
+	if (rx < np->rxmin)
+		np->rxmin = rx;
+	if (rx > np->rxmax)
+		np->rxmax = rx;
+	if (tx < np->txmin)
+		np->txmin = tx;
+	if (tx > np->txmax)
+		np->txmax = tx;
+}
+
+/*
+ * Advance `graph' to its next column, and fill it in with the mean
+ * per-second rates at `ratep' and whatever was sampled since the last one.
+ */
+void
+ifgraph_add(ifgraph_t *graph, const ifrates_t *ratep)
+{
+	unsigned int	col;
+	ifgcol_t	*colp;
+
+	col = graph->col = (graph->col + 1) % graph->ncols;
+	colp = &graph->cols[col];
+	*colp = graph->next;
+	(void) memset(&graph->next, 0, sizeof (ifgcol_t));
+
+	colp->rxmean = ratep->rxbytes;
+	colp->txmean = ratep->txbytes;
+
+	/*
+	 * The samples needn't cover the whole column, so the mean might
+	 * fall outside of them.
+	 */
+	if (colp->count == 0 || colp->rxmean < colp->rxmin)
+		colp->rxmin = colp->rxmean;
+	if (colp->count == 0 || colp->rxmean > colp->rxmax)
+		colp->rxmax = colp->rxmean;
+	if (colp->count == 0 || colp->txmean < colp->txmin)
+		colp->txmin = colp->txmean;
+	if (colp->count == 0 || colp->txmean > colp->txmax)
+		colp->txmax = colp->txmean;
+
+	ifgraph_bars(graph, colp);
+
+	/*
+	 * If the column we just collected either is too large to fit
+	 * in the graph or is replacing a column that was previously
+	 * the biggest value, then rescale.
+	 */
+	if ((ifgraph_value(graph, colp) >=
+	    (double)graph->bps2bar * (graph->height - 1)) ||
+	    (col == graph->maxcol))
+		ifgraph_rescale(graph);
+}
+
+/*
+ * Rescale the ifgraph_t pointed to by `graph'.
+ */
+void
+ifgraph_rescale(ifgraph_t *graph)
+{
+	unsigned int	col;
+	unsigned int	height = graph->height;
+	ulonglong_t	maxbytes = 0, bytes = 0;
+	ulonglong_t	scale = graph->bps2bar;
+
+	/*
+	 * First, find the biggest value...
+	 */
+	for (col = 0; col < graph->ncols; col++) {
+		bytes = ifgraph_value(graph, &graph->cols[col]);
+		if (bytes >= maxbytes) {
+			maxbytes = bytes;
+			graph->maxcol = col;
+		}
+	}
+
+	if ((maxbytes / scale) >= (height - 1)) {
+		while ((maxbytes / scale) >= (height - 1))
+			scale *= 2;
+	} else {
+		/*
+		 * See if we need to scale down.
+		 */
+		while (scale > graph->minbps2bar) {
+			if ((maxbytes / (scale / 2)) >= (height - 1))
+				break;
+			scale /= 2;
+		}
+	}
+
+	if (scale != graph->bps2bar) {
+		graph->bps2bar = scale;
+		for (col = 0; col < graph->ncols; col++)
+			ifgraph_bars(graph, &graph->cols[col]);
+	}
+}
+
+/*
+ * Return the bytes per second that column `colp' of `graph' needs room
+ * for.
+ */
+static double
+ifgraph_value(const ifgraph_t *graph, const ifgcol_t *colp)
+{
+	if (graph->scale == IFG_SCALEPEAK)
+		return (colp->rxmax + colp->txmax);
+
+	return (colp->rxmean + colp->txmean);
+}
+
+/*
+ * Work out the bar heights for column `colp' of `graph' at its current
+ * scale.  When scaling to fit the means, a peak may not fit, in which
+ * case it's pinned to the top.
+ */
+static void
+ifgraph_bars(const ifgraph_t *graph, ifgcol_t *colp)
+{
+	double perbar = 1.0 / graph->bps2bar;
+
+	colp->tbar = ifgraph_bar(graph, colp->txmean * perbar);
+	colp->rbar = ifgraph_bar(graph, colp->rxmean * perbar);
+	colp->tpeak = ifgraph_bar(graph, colp->txmax * perbar);
+	colp->rpeak = ifgraph_bar(graph, colp->rxmax * perbar);
+}
+
+/*
+ * Return the height of a bar `bar' pixels tall on `graph', pinned to the
+ * top if it doesn't fit.
+ */
+static unsigned char
+ifgraph_bar(const ifgraph_t *graph, double bar)
+{
+	return (bar < graph->height ? (unsigned char)bar : graph->height);
+}
+
+/*
+ * Work out how the bps meter shows `bps': the power of ten (which picks
+ * the speed letter), where the decimal point goes, and the digits.
+ */
+void
+bps_layout(ulonglong_t bps, bpslayout_t *blp)
+{
+	unsigned int	tens = 0;
+	unsigned int	decplace = 0;
+	int		place;
+
+	if (bps > 10)
+		tens++;
+	if (bps > 100)
+		tens++;
+	while (bps >= 1000) {
+		tens++;
+		decplace = (decplace + 1) % 3;
+		bps /= 10;
+	}
+
+	/*
+	 * Ceiling the maximum throughput at 999 gbps for now.
+	 */
+	if (tens > 11) {
+		tens = 11;
+		bps = 999;
+		decplace = 0;
+	}
+
+	blp->tens = tens;
+	blp->decplace = -1;
+
+	if (bps == 0) {
+		blp->first = WN_BPS_NDIGITS - 1;
+		blp->digits[WN_BPS_NDIGITS - 1] = 0;
+		return;
+	}
+
+	if (decplace > 0 || tens < 3)
+		blp->decplace = decplace;
+
+	blp->first = 0;
+	for (place = WN_BPS_NDIGITS - 1; place >= 0; place--, bps /= 10)
+		blp->digits[place] = bps % 10;
+}
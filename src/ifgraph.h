@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Graph and meter arithmetic -- how the rates end up being scaled into
+ * columns and laid out as digits, independent of how they're drawn.
+ */
+
+#ifndef	WN_IFGRAPH_H
+#define	WN_IFGRAPH_H
+
+#pragma ident "@(#)ifgraph.h	1.1	26/10/17 meem"
+
+#include <sys/types.h>
+
+#include "ifstat.h"
+
+/*
+ * One column of the graph.  The mean is over the column's whole span
+ * (it's what the bars show); the lowest and highest are of the rates
+ * sampled during it, of which there were `count'.  Floats are plenty for
+ * drawing, and bar heights fit in a byte (no look's graph is anywhere
+ * near 256 pixels tall), which keeps a column to 32 bytes.
+ */
+typedef struct {
+	float		rxmean, rxmin, rxmax;	/* received bytes/sec */
+	float		txmean, txmin, txmax;	/* sent bytes/sec */
+	unsigned int	count;		/* rates sampled during the column */
+	unsigned char	rbar, tbar;	/* receive and transmit bar heights */
+	unsigned char	rpeak, tpeak;	/* heights their peaks reach */
+} ifgcol_t;
+
+/*
+ * What the graph is scaled to fit: the mean of each column, or its peak
+ * (in which case the means look smaller, but every peak is on the graph).
+ */
+typedef enum { IFG_SCALEMEAN, IFG_SCALEPEAK } ifgscale_t;
+
+/*
+ * The network activity graph: the last `ncols' columns, and the height
+ * (in pixels, each worth `bps2bar' bytes per second) of the transmit and
+ * receive bars that show them.  Rates sampled during the column to come
+ * are gathered up in `next' until it's added.
+ */
+typedef struct ifgraph {
+	ulonglong_t	bps2bar;	/* bps -> bar conversion */
+	ulonglong_t	minbps2bar;	/* smallest bps2bar we scale down to */
+	unsigned int	ncols;		/* number of columns in graph */
+	unsigned int	height;		/* height of each column */
+	ifgscale_t	scale;		/* what `bps2bar' is chosen to fit */
+	ifgcol_t	*cols;		/* the columns */
+	ifgcol_t	next;		/* rates sampled for the next column */
+	unsigned int	col;		/* current column in graph */
+	unsigned int	maxcol;		/* column controlling bps2bar */
+} ifgraph_t;
+
+/*
+ * The bps meter shows three digits, a decimal point and a letter for the
+ * power of a thousand; bps_layout() works out which.
+ */
+#define	WN_BPS_NDIGITS	3
+
+typedef struct {
+	unsigned int	tens;		/* power of ten of the value */
+	int		decplace;	/* decimal point place (-1 if none) */
+	unsigned int	first;		/* first digit place that's shown */
+	unsigned int	digits[WN_BPS_NDIGITS];	/* digit in each place */
+} bpslayout_t;
+
+extern ifgraph_t	*ifgraph_create(unsigned int, unsigned int,
+			    ulonglong_t, ifgscale_t);
+extern void		ifgraph_destroy(ifgraph_t *);
+extern void		ifgraph_sample(ifgraph_t *, double, double);
+extern void		ifgraph_add(ifgraph_t *, const ifrates_t *);
+extern void		ifgraph_rescale(ifgraph_t *);
+extern void		bps_layout(ulonglong_t, bpslayout_t *);
+
+#endif /* WN_IFGRAPH_H */
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Compressed interface history routines.  See ifhist.h for the encoding.
+ */
+
+#pragma ident "@(#)ifhist.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ifhist.h"
+#include "ifrec.h"
+#include "utils.h"
+
+#define	WN_NSPERMSEC	1000000ULL	/* nanoseconds per millisecond */
+
+/*
+ * The most a sample can take: a control byte and three varints.
+ */
+#define	WN_IFHIST_MAXSAMPLE	(1 + 3 * WN_IFREC_MAXVARINT)
+
+typedef struct ifhblk {
+	struct ifhblk	*next;		/* next (newer) block */
+	ulonglong_t	stamp;		/* first sample, as is */
+	ulonglong_t	rxbytes;
+	ulonglong_t	txbytes;
+	unsigned int	nsamples;	/* samples in the block */
+	unsigned int	len;		/* bytes of `data' used */
+	unsigned char	data[WN_IFHIST_BLKSIZE]; /* the rest, encoded */
+} ifhblk_t;
+
+struct ifhist {
+	ifhblk_t	*head;		/* oldest block */
+	ifhblk_t	*tail;		/* newest block */
+	ifhblk_t	*spare;		/* block to reuse, if any */
+	ulonglong_t	span;		/* milliseconds to keep */
+	unsigned long	nblocks;	/* blocks in use */
+	unsigned long	nsamples;	/* samples in them */
+	ulonglong_t	stamp;		/* last sample added */
+	ulonglong_t	rxbytes;
+	ulonglong_t	txbytes;
+	long long	dstamp;		/* ... and its deltas */
+	long long	drxbytes;
+	long long	dtxbytes;
+};
+
+static unsigned char	*ifh_put(unsigned char *, long long, unsigned int,
+			    unsigned int *);
+static long long	ifh_get(const unsigned char **, const unsigned char *);
+
+/*
+ * Create a history that keeps at least the last `secs' seconds of
+ * samples.  If it returns, the pointer returned is guaranteed to be
+ * valid.
+ */
+ifhist_t *
+ifhist_create(unsigned int secs)
+{
+	ifhist_t *hp;
+
+	hp = calloc(1, sizeof (ifhist_t));
+	if (hp == NULL)
+		die("cannot allocate interface history");
+
+	hp->span = (ulonglong_t)secs * 1000;
+	return (hp);
+}
+
+/*
+ * Destroy the history pointed to by `hp'.
+ */
+void
+ifhist_destroy(ifhist_t *hp)
+{
+	ifhblk_t *blkp;
+
+	while ((blkp = hp->head) != NULL) {
+		hp->head = blkp->next;
+		free(blkp);
+	}
+	free(hp->spare);
+	free(hp);
+}
+
+/*
+ * Add a sample, taken at if_statstamp() time `stamp', of `rxbytes'
+ * received and `txbytes' sent to the history pointed to by `hp'.  Once
+ * the next-to-oldest block is older than the span, the oldest one is
+ * dropped (and kept around to be reused).
+ */
+void
+ifhist_add(ifhist_t *hp, ulonglong_t stamp, ulonglong_t rxbytes,
+    ulonglong_t txbytes)
+{
+	ifhblk_t	*blkp = hp->tail;
+	unsigned char	*cp, *ctlp;
+	unsigned int	ctl = 0;
+	long long	dstamp, drx, dtx;
+
+	stamp /= WN_NSPERMSEC;
+	if (blkp == NULL ||
+	    blkp->len + WN_IFHIST_MAXSAMPLE > WN_IFHIST_BLKSIZE) {
+		if ((blkp = hp->spare) != NULL)
+			hp->spare = NULL;
+		else if ((blkp = malloc(sizeof (ifhblk_t))) == NULL)
+			die("cannot allocate interface history");
+
+		blkp->next = NULL;
+		blkp->stamp = stamp;
+		blkp->rxbytes = rxbytes;
+		blkp->txbytes = txbytes;
+		blkp->nsamples = 1;
+		blkp->len = 0;
+		if (hp->tail != NULL)
+			hp->tail->next = blkp;
+		else
+			hp->head = blkp;
+		hp->tail = blkp;
+		hp->nblocks++;
+		hp->nsamples++;
+
+		hp->dstamp = hp->drxbytes = hp->dtxbytes = 0;
+		goto done;
+	}
+
+	dstamp = stamp - hp->stamp;
+	drx = rxbytes - hp->rxbytes;
+	dtx = txbytes - hp->txbytes;
+
+	ctlp = &blkp->data[blkp->len];
+	cp = ctlp + 1;
+	cp = ifh_put(cp, dstamp - hp->dstamp, WN_IFHIST_STAMP, &ctl);
+	cp = ifh_put(cp, drx - hp->drxbytes, WN_IFHIST_RX, &ctl);
+	cp = ifh_put(cp, dtx - hp->dtxbytes, WN_IFHIST_TX, &ctl);
+	*ctlp = ctl;
+
+	blkp->len = cp - blkp->data;
+	blkp->nsamples++;
+	hp->nsamples++;
+	hp->dstamp = dstamp;
+	hp->drxbytes = drx;
+	hp->dtxbytes = dtx;
+done:
+	hp->stamp = stamp;
+	hp->rxbytes = rxbytes;
+	hp->txbytes = txbytes;
+
+	while (hp->head != hp->tail &&
+	    hp->head->next->stamp + hp->span <= stamp) {
+		blkp = hp->head;
+		hp->head = blkp->next;
+		hp->nblocks--;
+		hp->nsamples -= blkp->nsamples;
+		if (hp->spare == NULL)
+			hp->spare = blkp;
+		else
+			free(blkp);
+	}
+}
+
+/*
+ * Start `iterp' at the oldest sample in the history pointed to by `hp'.
+ * Adding to the history invalidates it.
+ */
+void
+ifhist_iter(const ifhist_t *hp, ifhiter_t *iterp)
+{
+	(void) memset(iterp, 0, sizeof (ifhiter_t));
+	iterp->blkp = hp->head;
+	if (iterp->blkp != NULL)
+		iterp->n = iterp->blkp->nsamples;
+}
+
+/*
+ * Decode the sample at `iterp' into `stampp' (its if_statstamp() time,
+ * to the millisecond), `rxp' and `txp', and move on to the next one.
+ * Return 1 on success, or 0 if there are no more.
+ */
+int
+ifhist_next(ifhiter_t *iterp, ulonglong_t *stampp, ulonglong_t *rxp,
+    ulonglong_t *txp)
+{
+	const ifhblk_t		*blkp = iterp->blkp;
+	const unsigned char	*cp, *end;
+	unsigned int		ctl;
+
+	while (blkp != NULL && iterp->n == 0) {
+		blkp = iterp->blkp = blkp->next;
+		iterp->off = 0;
+		if (blkp != NULL)
+			iterp->n = blkp->nsamples;
+	}
+	if (blkp == NULL)
+		return (0);
+
+	if (iterp->n-- == blkp->nsamples) {
+		iterp->stamp = blkp->stamp;
+		iterp->rxbytes = blkp->rxbytes;
+		iterp->txbytes = blkp->txbytes;
+		iterp->dstamp = iterp->drxbytes = iterp->dtxbytes = 0;
+	} else {
+		cp = &blkp->data[iterp->off];
+		end = &blkp->data[blkp->len];
+		ctl = *cp++;
+		if (ctl & WN_IFHIST_STAMP)
+			iterp->dstamp += ifh_get(&cp, end);
+		if (ctl & WN_IFHIST_RX)
+			iterp->drxbytes += ifh_get(&cp, end);
+		if (ctl & WN_IFHIST_TX)
+			iterp->dtxbytes += ifh_get(&cp, end);
+		iterp->off = cp - blkp->data;
+		iterp->stamp += iterp->dstamp;
+		iterp->rxbytes += iterp->drxbytes;
+		iterp->txbytes += iterp->dtxbytes;
+	}
+
+	*stampp = iterp->stamp * WN_NSPERMSEC;
+	*rxp = iterp->rxbytes;
+	*txp = iterp->txbytes;
+	return (1);
+}
+
+/*
+ * Store the number of samples in the history pointed to by `hp' in
+ * `nsamplesp', and the bytes it takes up in `sizep'.
+ */
+void
+ifhist_usage(const ifhist_t *hp, unsigned long *nsamplesp, size_t *sizep)
+{
+	*nsamplesp = hp->nsamples;
+	*sizep = sizeof (ifhist_t) + (hp->nblocks + (hp->spare != NULL)) *
+	    sizeof (ifhblk_t);
+}
+
+/*
+ * If `val' is non-zero, store it zigzag-encoded as a varint at `cp', set
+ * `flag' in `*ctlp', and return a pointer just past it; otherwise, just
+ * return `cp'.
+ */
+static unsigned char *
+ifh_put(unsigned char *cp, long long val, unsigned int flag,
+    unsigned int *ctlp)
+{
+	if (val == 0)
+		return (cp);
+
+	*ctlp |= flag;
+	return (ifrec_putvarint(cp, ((unsigned long long)val << 1) ^
+	    (unsigned long long)(val >> 63)));
+}
+
+/*
+ * Decode the zigzag-encoded varint at `*cpp' (which must end before
+ * `end'), and move `*cpp' past it.  Blocks are only ever written by
+ * ifhist_add(), so it can't be malformed.
+ */
+static long long
+ifh_get(const unsigned char **cpp, const unsigned char *end)
+{
+	unsigned long long val = 0;
+
+	*cpp = ifrec_getvarint(*cpp, end, &val);
+	return ((long long)(val >> 1) ^ -(long long)(val & 1));
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Compressed interface history.  A history holds every sample of an
+ * interface's byte counters for (at least) a given span, packed into
+ * fixed-size blocks that are dropped, oldest first, as they age out.
+ *
+ * Each block starts with its first sample stored as is; every sample
+ * after that is stored as the change in its change (delta-of-delta) of
+ * the timestamp, in milliseconds, and of each counter.  Sampling on a
+ * schedule and steady traffic both make those mostly zero, so a sample
+ * is a control byte saying which of the three are non-zero, followed by
+ * a zigzag-encoded varint (see ifrec.h) for each one that is:
+ *
+ *	byte	WN_IFHIST_STAMP | WN_IFHIST_RX | WN_IFHIST_TX, as needed
+ *	varint	timestamp delta-of-delta, if WN_IFHIST_STAMP
+ *	varint	received bytes delta-of-delta, if WN_IFHIST_RX
+ *	varint	sent bytes delta-of-delta, if WN_IFHIST_TX
+ *
+ * An idle interface takes a byte a sample; a busy one a few more.
+ * Decoding runs straight through each block, so walking the lot (to
+ * export or draw it) is cheap too.
+ */
+
+#ifndef	WN_IFHIST_H
+#define	WN_IFHIST_H
+
+#pragma ident "@(#)ifhist.h	1.1	26/10/17 meem"
+
+#include <sys/types.h>
+
+#define	WN_IFHIST_BLKSIZE	4096	/* encoded bytes per block */
+
+#define	WN_IFHIST_STAMP		0x01
+#define	WN_IFHIST_RX		0x02
+#define	WN_IFHIST_TX		0x04
+
+typedef struct ifhist ifhist_t;
+
+/*
+ * A position in a history; see ifhist_iter() and ifhist_next().
+ */
+typedef struct {
+	const struct ifhblk *blkp;	/* block being decoded */
+	unsigned int	off;		/* offset of the next sample in it */
+	unsigned int	n;		/* samples left in it */
+	ulonglong_t	stamp;		/* last sample decoded */
+	ulonglong_t	rxbytes;
+	ulonglong_t	txbytes;
+	long long	dstamp;		/* ... and its deltas */
+	long long	drxbytes;
+	long long	dtxbytes;
+} ifhiter_t;
+
+extern ifhist_t		*ifhist_create(unsigned int);
+extern void		ifhist_destroy(ifhist_t *);
+extern void		ifhist_add(ifhist_t *, ulonglong_t, ulonglong_t,
+			    ulonglong_t);
+extern void		ifhist_iter(const ifhist_t *, ifhiter_t *);
+extern int		ifhist_next(ifhiter_t *, ulonglong_t *, ulonglong_t *,
+			    ulonglong_t *);
+extern void		ifhist_usage(const ifhist_t *, unsigned long *,
+			    size_t *);
+
+#endif /* WN_IFHIST_H */
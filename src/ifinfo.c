@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * The rate engine: sampling an interface's counters, turning them into
+ * per-second rates, and smoothing the result.  Shared by the dockapp and
+ * the headless collector, so nothing in here may know about X.
+ */
+
+#pragma ident "@(#)ifinfo.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "ifhist.h"
+#include "ifinfo.h"
+#include "sched.h"
+#include "utils.h"
+
+#define	WN_NSPERSEC	1000000000ULL	/* nanoseconds per second */
+
+const unsigned int ifwin_secs[WN_IFWIN_NWINS] = { 1, 10, 60, 300 };
+
+static void	ifwin_update(ifwindow_t *, unsigned int, const ifinfo_t *);
+
+/*
+ * Create an ifinfo_t for an interface named `ifname', gathering its stats
+ * through `statep'.  If it returns, the pointer returned is guaranteed to
+ * be valid.
+ */
+ifinfo_t *
+ifinfo_create(const char *ifname, ifstat_t *statep)
+{
+	ifinfo_t *ifp;
+
+	ifp = calloc(1, sizeof (ifinfo_t));
+	if (ifp == NULL)
+		die("cannot allocate interface information structure");
+
+	ifp->name = strdup(ifname);
+	if (ifp->name == NULL)
+		die("cannot allocate interface name");
+
+	ifp->statep = statep;
+	return (ifp);
+}
+
+/*
+ * Destroy the ifinfo_t pointed to by `ifp', along with its history (if
+ * any).  Its graph, if any, must already have been freed by whoever
+ * created it.
+ */
+void
+ifinfo_destroy(ifinfo_t *ifp)
+{
+	if (ifp->hist != NULL)
+		ifhist_destroy(ifp->hist);
+	free(ifp->name);
+	free(ifp);
+}
+
+/*
+ * Sample the stats on the interface described by `ifp' into `samplep', and
+ * update its status.  Return 1 on success, 0 on failure.
+ */
+int
+ifinfo_sample(ifinfo_t *ifp, iflist_t *iflp, ifsample_t *samplep)
+{
+	if (if_stats(ifp->name, ifp->statep, &samplep->stats) == 0) {
+		ifp->status = IF_UNKNOWN;
+		return (0);
+	}
+
+	samplep->ifindex = if_statifindex(ifp->statep);
+	samplep->stamp = if_statstamp(ifp->statep);
+	ifp->status = if_status(iflp, ifp->name, if_statflags(ifp->statep));
+	return (1);
+}
+
+/*
+ * Like ifinfo_sample(), but find the stats on the interface described by
+ * `ifp' in the already-taken snapshot `snap'.
+ */
+int
+ifinfo_snapsample(ifinfo_t *ifp, iflist_t *iflp, const ifstatsnap_t *snap,
+    ifsample_t *samplep)
+{
+	unsigned int i;
+
+	for (i = 0; i < snap->nents; i++) {
+		if (strcmp(snap->ents[i].name, ifp->name) == 0) {
+			samplep->stats = snap->ents[i].stats;
+			samplep->ifindex = snap->ents[i].ifindex;
+			samplep->stamp = if_statstamp(ifp->statep);
+			ifp->status = if_status(iflp, ifp->name,
+			    snap->ents[i].flags);
+			return (1);
+		}
+	}
+
+	ifp->status = IF_UNKNOWN;
+	return (0);
+}
+
+/*
+ * Fold the sample at `samplep' into the counters and rates for the
+ * interface described by `ifp'.  The rates are over the time that
+ * actually passed since the last sample rather than the nominal interval,
+ * so a late wakeup doesn't skew them.  Passing the last sample again (say,
+ * because the new one failed) yields zero rates without disturbing the
+ * baseline; if there's no baseline yet, the sample just becomes it.
+ *
+ * Counters that wrapped at 32 bits are carried on into 64.  If instead
+ * the counters were reset or the interface was re-created (its index
+ * changed), the sample is discarded: it yields zero rates, since there's
+ * no telling how much traffic went by, and just becomes the new baseline.
+ * Otherwise, the spike would wreck the graph's scale for a whole screen.
+ * Any sample that moves time along is also checkpointed in the rolling
+ * windows, as they see fit, and added to the history (if any).
+ */
+void
+ifinfo_update(ifinfo_t *ifp, const ifsample_t *samplep)
+{
+	ifstats_t		delta, ostats;
+	unsigned long long	*cp = (unsigned long long *)&ifp->stats;
+	const unsigned long long *dp = (const unsigned long long *)&delta;
+	unsigned int		i;
+
+	ifp->orate = ifp->rate;
+	ifp->elapsed = 0;
+	(void) memset(&ifp->rate, 0, sizeof (ifrates_t));
+
+	if (ifp->last.stamp == 0) {
+		ifp->stats = samplep->stats;
+		ifp->last = *samplep;
+		goto windows;
+	}
+
+	if (samplep->stamp <= ifp->last.stamp)
+		return;
+
+	if ((samplep->ifindex != ifp->last.ifindex && samplep->ifindex != 0 &&
+	    ifp->last.ifindex != 0) ||
+	    !if_statsdelta(&samplep->stats, &ifp->last.stats, &delta)) {
+		ifp->discards++;
+		ifp->last = *samplep;
+		goto windows;
+	}
+
+	ostats = ifp->stats;
+	for (i = 0; i < WN_IFSTATS_NCTRS; i++)
+		cp[i] += dp[i];
+
+	ifp->elapsed = samplep->stamp - ifp->last.stamp;
+	if_statsrate(&ifp->stats, &ostats, ifp->elapsed, &ifp->rate);
+	ifp->last = *samplep;
+windows:
+	for (i = 0; i < WN_IFWIN_NWINS; i++)
+		ifwin_update(&ifp->windows[i], ifwin_secs[i], ifp);
+
+	if (ifp->hist != NULL) {
+		ifhist_add(ifp->hist, ifp->last.stamp, ifp->stats.rxbytes,
+		    ifp->stats.txbytes);
+	}
+}
+
+/*
+ * Store the average rates, in bytes per second, that the interface
+ * described by `ifp' received and sent over rolling window `win' in `rxp'
+ * and `txp'.  The average is over the time since the newest checkpoint
+ * that's at least the window's length old (or the oldest, until there is
+ * one), so it spans at most 1/(WN_IFWIN_NSLOTS - 1) more than the window.
+ * Return the nanoseconds it spans, or 0 if there's nothing to go on yet.
+ */
+ulonglong_t
+ifinfo_window(const ifinfo_t *ifp, unsigned int win, double *rxp,
+    double *txp)
+{
+	const ifwindow_t	*wp = &ifp->windows[win];
+	const ifcheck_t		*cp, *fromp = NULL;
+	ulonglong_t		now = ifp->last.stamp, span;
+	unsigned int		i, slot;
+
+	*rxp = *txp = 0.0;
+	slot = (wp->next + WN_IFWIN_NSLOTS - wp->nslots) % WN_IFWIN_NSLOTS;
+	for (i = 0; i < wp->nslots; i++) {
+		cp = &wp->slots[slot];
+		if (fromp != NULL &&
+		    now - cp->stamp < ifwin_secs[win] * WN_NSPERSEC)
+			break;
+		fromp = cp;
+		slot = (slot + 1) % WN_IFWIN_NSLOTS;
+	}
+
+	if (fromp == NULL || (span = now - fromp->stamp) == 0)
+		return (0);
+
+	*rxp = (double)(ifp->stats.rxbytes - fromp->rxbytes) * 1e9 / span;
+	*txp = (double)(ifp->stats.txbytes - fromp->txbytes) * 1e9 / span;
+	return (span);
+}
+
+/*
+ * Return the rolling window that's `secs' seconds long, or -1 if there
+ * isn't one.
+ */
+int
+ifinfo_winlookup(unsigned int secs)
+{
+	unsigned int i;
+
+	for (i = 0; i < WN_IFWIN_NWINS; i++) {
+		if (ifwin_secs[i] == secs)
+			return (i);
+	}
+	return (-1);
+}
+
+/*
+ * Checkpoint the counters of the interface described by `ifp' in the
+ * rolling window pointed to by `wp', which is `secs' seconds long, if
+ * it's been long enough since the last checkpoint.
+ */
+static void
+ifwin_update(ifwindow_t *wp, unsigned int secs, const ifinfo_t *ifp)
+{
+	ifcheck_t	*cp;
+	unsigned int	last;
+
+	if (wp->nslots != 0) {
+		last = (wp->next + WN_IFWIN_NSLOTS - 1) % WN_IFWIN_NSLOTS;
+		if (ifp->last.stamp - wp->slots[last].stamp <
+		    secs * WN_NSPERSEC / (WN_IFWIN_NSLOTS - 1))
+			return;
+	}
+
+	cp = &wp->slots[wp->next];
+	cp->stamp = ifp->last.stamp;
+	cp->rxbytes = ifp->stats.rxbytes;
+	cp->txbytes = ifp->stats.txbytes;
+	wp->next = (wp->next + 1) % WN_IFWIN_NSLOTS;
+	if (wp->nslots < WN_IFWIN_NSLOTS)
+		wp->nslots++;
+}
+
+/*
+ * Check if the named interface is functioning.  If `flags' isn't -1, then
+ * the statistics implementation already learned the interface flags while
+ * gathering statistics, so use those rather than asking again.
+ */
+ifstatus_t
+if_status(iflist_t *iflp, const char *ifname, int flags)
+{
+	if (flags == -1)
+		flags = iflist_flags(iflp, ifname);
+
+	if (flags == -1)
+		return (IF_UNKNOWN);
+
+	return ((flags & IFF_UP) != 0 ? IF_UP : IF_DOWN);
+}
+
+/*
+ * Initialize a smoothing table containing `niter + 1' elements.
+ */
+double *
+smoothtable_init(unsigned int niter)
+{
+	unsigned int iter;
+	unsigned int nslice = 0;
+	double *smoothtable;
+
+	smoothtable = calloc(niter + 1, sizeof (double));
+	if (smoothtable == NULL)
+		return (NULL);
+
+	for (iter = 0; iter <= niter; iter++)
+		nslice += (iter * (iter + 1));
+
+	for (iter = 0; iter <= niter; iter++)
+		smoothtable[iter] = (double)(iter * (iter + 1)) / nslice;
+
+	return (smoothtable);
+}
+
+/*
+ * Initialize the smoothing time table, using the general smoothing table
+ * named by `smoothtable', the total amount of time per update interval (in
+ * milliseconds, and the total number of smoothing iterations per update
+ * interval.
+ */
+unsigned int *
+timetable_init(double smoothtable[], unsigned int interval, unsigned int niter)
+{
+	unsigned int *timetable;
+	unsigned int iter;
+
+	timetable = calloc(niter + 1, sizeof (unsigned int));
+	if (timetable == NULL)
+		return (NULL);
+
+	timetable[0] = interval;
+	for (iter = 1; iter < niter; iter++)
+		timetable[iter] = timetable[iter - 1] -
+		    (interval * smoothtable[iter]);
+	timetable[niter] = 0;
+
+	return (timetable);
+}
+
+/* XXX niter should be part of smoothtable */
+void
+next_bps(double smoothtable[], unsigned int iter, unsigned int niter,
+    ifinfo_t *ifp)
+{
+	double	num;
+	double	onum;
+
+	num = ifp->rate.rxbytes + ifp->rate.txbytes;
+	onum = ifp->orate.rxbytes + ifp->orate.txbytes;
+
+	if (iter < niter)
+		ifp->bps += (num - onum) * smoothtable[niter + 1 - iter];
+	else
+		ifp->bps = num;
+}
+
+/*
+ * Given the byte rates over the last interval (`ratep') and the one before
+ * (`oratep'), work out how to sample the next one: `*nsubp' samples spread
+ * across each `interval' milliseconds, or one sample after `*nidlep'
+ * intervals.  While the rate is changing by more than half, sample
+ * faster, so that a burst shows up on the meter as it happens; once it
+ * settles, ease back.  While the counters aren't moving at all, back off
+ * exponentially, since there's nothing to see -- at the price of noticing
+ * the next burst up to WN_ADAPT_MAXIDLE intervals late.
+ */
+void
+next_adapt(const ifrates_t *ratep, const ifrates_t *oratep,
+    unsigned int interval, unsigned int *nsubp, unsigned int *nidlep)
+{
+	double		num, onum, delta;
+	unsigned int	maxsub;
+
+	num = ratep->rxbytes + ratep->txbytes;
+	onum = oratep->rxbytes + oratep->txbytes;
+
+	if (num == 0) {
+		*nsubp = 1;
+		if (onum == 0 && *nidlep < WN_ADAPT_MAXIDLE)
+			*nidlep *= 2;
+		else if (onum != 0)
+			*nidlep = 1;
+		return;
+	}
+
+	/*
+	 * Never sample more often than the schedule allows.
+	 */
+	maxsub = interval / WN_SCHED_MINMS;
+	if (maxsub > WN_ADAPT_MAXSUB)
+		maxsub = WN_ADAPT_MAXSUB;
+	if (maxsub == 0)
+		maxsub = 1;
+
+	*nidlep = 1;
+	delta = (num > onum) ? num - onum : onum - num;
+	if (delta * 2 > (num > onum ? num : onum))
+		*nsubp = maxsub;
+	else if (*nsubp > 1)
+		*nsubp /= 2;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Rate engine interfaces -- everything needed to turn samples of an
+ * interface's counters into rates, independent of how (or whether) they
+ * end up being displayed.
+ */
+
+#ifndef	WN_IFINFO_H
+#define	WN_IFINFO_H
+
+#pragma ident "@(#)ifinfo.h	1.1	26/10/17 meem"
+
+#include <sys/time.h>
+
+#include "iflist.h"
+#include "ifstat.h"
+
+typedef enum { IF_UNKNOWN, IF_UP, IF_DOWN } ifstatus_t;
+
+/*
+ * Limits for adaptive sampling: while the rate is jumping around, up to
+ * WN_ADAPT_MAXSUB samples are taken per interval; while the counters are
+ * flat, samples are taken as little as once every WN_ADAPT_MAXIDLE.
+ */
+#define	WN_ADAPT_MAXSUB		4
+#define	WN_ADAPT_MAXIDLE	8
+
+/*
+ * Rolling windows: standing averages over about the last 1, 10, 60 and
+ * 300 seconds (ifwin_secs[]), like a load average.  Rather than keep
+ * every sample, each window keeps a ring of WN_IFWIN_NSLOTS checkpoints
+ * of the counters, taken at most every 1/(WN_IFWIN_NSLOTS - 1) of the
+ * window, so that keeping it up costs the same however long it is.
+ */
+#define	WN_IFWIN_NWINS		4
+#define	WN_IFWIN_NSLOTS		17
+
+typedef struct {
+	ulonglong_t	stamp;		/* if_statstamp() of the checkpoint */
+	ulonglong_t	rxbytes;	/* bytes received by then */
+	ulonglong_t	txbytes;	/* bytes sent by then */
+} ifcheck_t;
+
+typedef struct {
+	unsigned int	next;		/* next slot to fill */
+	unsigned int	nslots;		/* number of slots filled */
+	ifcheck_t	slots[WN_IFWIN_NSLOTS];	/* the checkpoints */
+} ifwindow_t;
+
+/*
+ * One sample of an interface's counters, as it came back from the
+ * backend, along with the interface index it came back with (or 0 if the
+ * backend doesn't know it) and its if_statstamp() time.
+ */
+typedef struct {
+	ifstats_t	stats;		/* raw counters */
+	unsigned int	ifindex;	/* interface index, or 0 */
+	ulonglong_t	stamp;		/* if_statstamp() of the sample */
+} ifsample_t;
+
+/*
+ * A monitored interface.  Its counters carry on into 64 bits when the
+ * backend's wrap at 32, and across counter resets and the interface being
+ * re-created, so they only ever go up.  Whoever wants a history of them
+ * hangs one off of `hist', which the engine then keeps (and frees).  The
+ * display, if any, hangs its graph off of `graph'; the engine itself
+ * never looks at it.
+ */
+typedef struct {
+	char		*name;		/* interface name */
+	ifstatus_t	status;		/* current status */
+	ulonglong_t	bps;		/* current (smoothed) bps */
+	ifstats_t	stats;		/* counters as of the last sample */
+	ifsample_t	last;		/* last sample, as taken */
+	ulonglong_t	discards;	/* samples discarded as resets */
+	ulonglong_t	elapsed;	/* nanoseconds spanned by `rate' */
+	ifrates_t	rate;		/* per-second rates, last interval */
+	ifrates_t	orate;		/* per-second rates, interval before */
+	ifwindow_t	windows[WN_IFWIN_NWINS]; /* rolling windows */
+	struct ifhist	*hist;		/* compressed history (if any) */
+	ifstat_t	*statep;	/* pointer to interface stats */
+	struct ifgraph	*graph;		/* display's graph (if any) */
+} ifinfo_t;
+
+extern const unsigned int ifwin_secs[WN_IFWIN_NWINS];
+
+extern ifinfo_t		*ifinfo_create(const char *, ifstat_t *);
+extern void		ifinfo_destroy(ifinfo_t *);
+extern int		ifinfo_sample(ifinfo_t *, iflist_t *, ifsample_t *);
+extern int		ifinfo_snapsample(ifinfo_t *, iflist_t *,
+			    const ifstatsnap_t *, ifsample_t *);
+extern void		ifinfo_update(ifinfo_t *, const ifsample_t *);
+extern ulonglong_t	ifinfo_window(const ifinfo_t *, unsigned int,
+			    double *, double *);
+extern int		ifinfo_winlookup(unsigned int);
+extern ifstatus_t	if_status(iflist_t *, const char *, int);
+
+extern double		*smoothtable_init(unsigned int);
+extern unsigned int	*timetable_init(double [], unsigned int, unsigned int);
+extern void		next_bps(double [], unsigned int, unsigned int,
+			    ifinfo_t *);
+extern void		next_adapt(const ifrates_t *, const ifrates_t *,
+			    unsigned int, unsigned int *, unsigned int *);
+
+#endif /* WN_IFINFO_H */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface list interfaces -- used to find out which interfaces exist
+ * and whether they're up.  Implementations that can be told about changes
+ * by the kernel provide a descriptor to wait on; the others just ask the
+ * kernel every time.
+ */
+
+#ifndef	WN_IFLIST_H
+#define	WN_IFLIST_H
+
+#pragma ident "@(#)iflist.h	1.1	26/10/17 meem"
+
+/*
+ * Each interface list implementation must define its own version of this
+ * structure.
+ */
+typedef struct iflist iflist_t;
+
+extern iflist_t		*iflist_init(void);
+extern int		iflist_fd(iflist_t *);
+extern int		iflist_update(iflist_t *);
+extern int		iflist_flags(iflist_t *, const char *);
+extern int		iflist_next(iflist_t *, const char *, char *);
+extern void		iflist_fini(iflist_t *);
+
+#endif /* WN_IFLIST_H */
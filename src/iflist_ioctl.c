@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2002-2003 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface list routines built on the SIOCGIFCONF and SIOCGIFFLAGS
+ * ioctls; these work (more or less) everywhere, but have to ask the
+ * kernel every time.
+ */
+
+#pragma ident "@(#)iflist_ioctl.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_SOCKIO_H
+#include <sys/sockio.h>
+#endif
+#ifdef HAVE_ALLOCA_H
+#include <alloca.h>
+#endif
+
+#include "iflist.h"
+#include "utils.h"
+
+struct iflist {
+	int	fd;		/* datagram socket for interface ioctls */
+};
+
+/*
+ * Do one-time setup for querying the interface list, and return the
+ * interface list state, or NULL on failure.
+ */
+iflist_t *
+iflist_init(void)
+{
+	iflist_t *iflp;
+
+	iflp = malloc(sizeof (iflist_t));
+	if (iflp == NULL) {
+		warn("cannot allocate interface list state");
+		return (NULL);
+	}
+
+	iflp->fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+	if (iflp->fd == -1) {
+		warn("cannot open datagram socket");
+		free(iflp);
+		return (NULL);
+	}
+
+	return (iflp);
+}
+
+/*
+ * Return the descriptor to wait on for interface list changes.  We never
+ * hear about changes, so there isn't one.
+ */
+/* ARGSUSED */
+int
+iflist_fd(iflist_t *iflp)
+{
+	return (-1);
+}
+
+/*
+ * Process pending interface list changes; return 1 if anything changed.
+ * Since we always ask the kernel, there's never anything to do.
+ */
+/* ARGSUSED */
+int
+iflist_update(iflist_t *iflp)
+{
+	return (0);
+}
+
+/*
+ * Get an interface's current flags, or -1 if the cannot be retrieved.
+ */
+int
+iflist_flags(iflist_t *iflp, const char *ifname)
+{
+	struct ifreq ifr;
+
+	(void) strncpy(ifr.ifr_name, ifname, IFNAMSIZ);
+	ifr.ifr_name[IFNAMSIZ - 1] = '\0';
+
+	if (ioctl(iflp->fd, SIOCGIFFLAGS, &ifr) == -1)
+		return (-1);
+
+	return (ifr.ifr_flags);
+}
+
+/*
+ * Return a pointer to the next ifreq structure after `ifrp'.  See the rant
+ * in iflist_next() for more on this misery.
+ */
+static struct ifreq *
+ifr_next(struct ifreq *ifrp)
+{
+	unsigned int len;
+
+#ifdef	HAVE_SOCKADDR_SA_LEN
+	len = ifrp->ifr_addr.sa_len;
+	if (len < sizeof (struct sockaddr))
+		len = sizeof (struct sockaddr);
+#else
+	switch (ifrp->ifr_addr.sa_family) {
+#ifdef	HAVE_IPV6
+	case AF_INET6:
+		len = sizeof (struct sockaddr_in6);
+		break;
+#endif
+	case AF_INET:
+	default:
+		len = sizeof (struct sockaddr);
+		break;
+	}
+#endif
+	len += sizeof (ifrp->ifr_name);
+	return ((struct ifreq *)((caddr_t)ifrp + len));
+}
+
+/*
+ * Fetch the name of the "next" interface in the interface list.  If the
+ * passed in interface name is empty, then return the first interface name
+ * in the list that isn't loopback (unless loopback is the only interface).
+ * If the next interface name cannot be determined, then 0 is returned.
+ */
+int
+iflist_next(iflist_t *iflp, const char *ifname, char *nextifname)
+{
+	struct ifconf	ifc;
+	struct ifreq	*ifrp, *matchifrp = NULL, *loifrp = NULL;
+	int		fd = iflp->fd;
+	void		*startp, *endp;
+	int		flags;
+	int		ifcount;
+	int		prevlen;
+
+	/*
+	 * Fetch the number of interfaces on the system.
+	 */
+#ifdef	SIOCGIFNUM
+	if (ioctl(fd, SIOCGIFNUM, &ifcount) == -1)
+		return (0);
+	ifc.ifc_len = ifcount * sizeof (struct ifreq);
+#else
+	/*
+	 * Unfortunately, different flavors of Unix have different semantics
+	 * for when the buffer is too small.  Specifically, some (like Linux)
+	 * will set ifc_len to be the size that would be needed to return all
+	 * of the interface information, whereas others (like FreeBSD) will
+	 * set ifc_len to be the amount of ifc_buf that was copied out to
+	 * userland.  Thus, we have to do this weird dance to support both.
+	 */
+	ifc.ifc_len = 0;
+	ifc.ifc_buf = NULL;
+	do {
+		prevlen = ifc.ifc_len;
+		ifc.ifc_len += 1024;
+		ifc.ifc_buf = realloc(ifc.ifc_buf, ifc.ifc_len);
+		if (ifc.ifc_buf == NULL) {
+			warn("cannot allocate interface information");
+			return (0);
+		}
+		if (ioctl(fd, SIOCGIFCONF, &ifc) == -1 || ifc.ifc_len <= 0) {
+			free(ifc.ifc_buf);
+			return (0);
+		}
+	} while (ifc.ifc_len > prevlen);
+
+	free(ifc.ifc_buf);
+#endif
+	/*
+	 * Allocate enough ifreq entries to store the results.
+	 */
+	ifc.ifc_req = alloca(ifc.ifc_len);
+	if (ioctl(fd, SIOCGIFCONF, &ifc) == -1)
+		return (0);
+
+	/*
+	 * *@@!*(&#$: A special thanks to the BSD team, for breaking the
+	 * SIOCGIFCONF interface when they introduced IPv6 support, by
+	 * making ifreqs vary in size.  To make matters worse, most Unices
+	 * do not support sa_len, so we don't even have a portable way to
+	 * step through the ifreqs.  Why BSD didn't just introduce a new
+	 * ioctl to retrieve the extended ifreqs is beyond me.
+	 */
+	startp = ifc.ifc_buf;
+	endp = ifc.ifc_buf + ifc.ifc_len;
+
+	/*
+	 * Loop through all the interface names.  If we were given an
+	 * interface name, then attempt to return the next interface
+	 * "after" it (looping around to the first interface, if need be).
+	 * If we weren't given an interface name, or if we cannot find the
+	 * requested interface name, then return the first non-loopback
+	 * interface.
+	 */
+	for (ifrp = startp; (void *)&ifrp[1] <= endp; ifrp = ifr_next(ifrp)) {
+		if (ifname != NULL && strcmp(ifrp->ifr_name, ifname) == 0) {
+			/*
+			 * Each interface ends up in the ifreq list once
+			 * for each address family it's configured with.
+			 * If these entries end up being consecutive, that
+			 * will screw up our iterator since we iterate
+			 * by name.  As such, make sure we skip to the
+			 * final instance of the name we find.
+			 */
+			matchifrp = ifrp;
+			do {
+				matchifrp = ifr_next(matchifrp);
+				if ((void *)&matchifrp[1] > endp)
+					matchifrp = startp;
+			} while (matchifrp != ifrp &&
+			    strcmp(ifrp->ifr_name, matchifrp->ifr_name) == 0);
+			break;
+		}
+
+		/*
+		 * Just in case we never find a non-loopback interface,
+		 * keep track of the first loopback interface we find.
+		 */
+		flags = iflist_flags(iflp, ifrp->ifr_name);
+		if (flags != -1 && (flags & IFF_LOOPBACK)) {
+			if (loifrp == NULL)
+				loifrp = ifrp;
+			continue;
+		}
+
+		/*
+		 * If this is the first non-loopback interface we've found,
+		 * then store it in `matchifrp' in case we don't find a
+		 * better match.
+		 */
+		if (matchifrp == NULL) {
+			matchifrp = ifrp;
+			if (ifname == NULL)
+				break;
+		}
+	}
+
+	if (matchifrp == NULL)
+		matchifrp = loifrp;
+
+	if (matchifrp != NULL) {
+		(void) strncpy(nextifname, matchifrp->ifr_name, IFNAMSIZ);
+		nextifname[IFNAMSIZ - 1] = '\0';
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * Clean up the interface list state pointed to by `iflp'.
+ */
+void
+iflist_fini(iflist_t *iflp)
+{
+	(void) close(iflp->fd);
+	free(iflp);
+}
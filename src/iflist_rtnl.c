@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Linux interface list routines built on rtnetlink.  We take one dump of
+ * the links at startup and then keep an in-memory table current by
+ * listening for link notifications, so that checking an interface's
+ * flags or finding the next interface costs no system calls at all.
+ * Unlike SIOCGIFCONF, this also sees interfaces that have no addresses.
+ */
+
+#pragma ident "@(#)iflist_rtnl.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iflist.h"
+#include "utils.h"
+
+#define	WN_NL_MINBUF	32768		/* initial size of the receive buffer */
+
+typedef struct {
+	char		name[IFNAMSIZ];	/* interface name */
+	int		ifindex;	/* interface index */
+	int		flags;		/* interface flags */
+} iflent_t;
+
+struct iflist {
+	int		fd;		/* rtnetlink socket */
+	unsigned int	seq;		/* sequence number of last dump */
+	iflent_t	*ents;		/* interfaces, sorted by index */
+	unsigned int	nents;		/* number of entries in use */
+	unsigned int	maxents;	/* number of entries allocated */
+	char		*buf;		/* receive buffer */
+	size_t		bufsize;	/* allocated size of `buf' */
+};
+
+static int	rtnl_dump(iflist_t *);
+static void	rtnl_drain(iflist_t *);
+static int	rtnl_process(iflist_t *, size_t, int *);
+static int	rtnl_newlink(iflist_t *, struct nlmsghdr *);
+static int	rtnl_dellink(iflist_t *, struct nlmsghdr *);
+static iflent_t	*rtnl_lookup(iflist_t *, const char *);
+
+/*
+ * Do one-time setup for querying the interface list, and return the
+ * interface list state, or NULL on failure.
+ */
+iflist_t *
+iflist_init(void)
+{
+	iflist_t		*iflp;
+	struct sockaddr_nl	snl;
+
+	iflp = calloc(1, sizeof (iflist_t));
+	if (iflp == NULL) {
+		warn("cannot allocate interface list state");
+		return (NULL);
+	}
+
+	iflp->bufsize = WN_NL_MINBUF;
+	iflp->buf = malloc(iflp->bufsize);
+	if (iflp->buf == NULL) {
+		warn("cannot allocate interface list buffer");
+		free(iflp);
+		return (NULL);
+	}
+
+	iflp->fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (iflp->fd == -1) {
+		warn("cannot open rtnetlink socket");
+		goto fail;
+	}
+
+	(void) memset(&snl, 0, sizeof (snl));
+	snl.nl_family = AF_NETLINK;
+	snl.nl_groups = RTMGRP_LINK;
+	if (bind(iflp->fd, (struct sockaddr *)&snl, sizeof (snl)) == -1) {
+		warn("cannot subscribe to link notifications");
+		goto fail;
+	}
+
+	if (!rtnl_dump(iflp))
+		goto fail;
+
+	/*
+	 * From here on, we only read when the caller tells us there's
+	 * something to read -- but don't get stuck if we're wrong.
+	 */
+	if (fcntl(iflp->fd, F_SETFL, fcntl(iflp->fd, F_GETFL) | O_NONBLOCK)
+	    == -1) {
+		warn("cannot make rtnetlink socket non-blocking");
+		goto fail;
+	}
+
+	return (iflp);
+fail:
+	if (iflp->fd != -1)
+		(void) close(iflp->fd);
+	free(iflp->buf);
+	free(iflp->ents);
+	free(iflp);
+	return (NULL);
+}
+
+/*
+ * Return the descriptor to wait on for interface list changes.
+ */
+int
+iflist_fd(iflist_t *iflp)
+{
+	return (iflp->fd);
+}
+
+/*
+ * Process pending interface list changes; return 1 if anything changed.
+ */
+int
+iflist_update(iflist_t *iflp)
+{
+	ssize_t	len;
+	int	changed = 0;
+	int	done;
+
+	for (;;) {
+		len = recv(iflp->fd, iflp->buf, iflp->bufsize,
+		    MSG_DONTWAIT | MSG_TRUNC);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return (changed);
+			break;
+		}
+
+		if ((size_t)len > iflp->bufsize)
+			break;
+
+		changed |= rtnl_process(iflp, len, &done);
+	}
+
+	/*
+	 * We lost some notifications, either because the socket overflowed
+	 * or because one didn't fit in our buffer.  Either way, the only
+	 * thing to do is start over from a fresh dump.
+	 */
+	if (!rtnl_dump(iflp))
+		warn("cannot refresh interface list\n");
+
+	return (1);
+}
+
+/*
+ * Get an interface's current flags, or -1 if the cannot be retrieved.
+ */
+int
+iflist_flags(iflist_t *iflp, const char *ifname)
+{
+	iflent_t *entp = rtnl_lookup(iflp, ifname);
+
+	return (entp != NULL ? entp->flags : -1);
+}
+
+/*
+ * Fetch the name of the "next" interface in the interface list.  If the
+ * passed in interface name is empty, then return the first interface name
+ * in the list that isn't loopback (unless loopback is the only interface).
+ * If the next interface name cannot be determined, then 0 is returned.
+ */
+int
+iflist_next(iflist_t *iflp, const char *ifname, char *nextifname)
+{
+	iflent_t	*entp, *matchp = NULL, *lop = NULL;
+	unsigned int	i;
+
+	if (ifname != NULL && (entp = rtnl_lookup(iflp, ifname)) != NULL) {
+		i = (entp - iflp->ents + 1) % iflp->nents;
+		matchp = &iflp->ents[i];
+	}
+
+	for (i = 0; matchp == NULL && i < iflp->nents; i++) {
+		entp = &iflp->ents[i];
+		if (entp->flags & IFF_LOOPBACK) {
+			if (lop == NULL)
+				lop = entp;
+			continue;
+		}
+		matchp = entp;
+	}
+
+	if (matchp == NULL)
+		matchp = lop;
+
+	if (matchp != NULL) {
+		(void) strncpy(nextifname, matchp->name, IFNAMSIZ);
+		nextifname[IFNAMSIZ - 1] = '\0';
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * Clean up the interface list state pointed to by `iflp'.
+ */
+void
+iflist_fini(iflist_t *iflp)
+{
+	(void) close(iflp->fd);
+	free(iflp->buf);
+	free(iflp->ents);
+	free(iflp);
+}
+
+/*
+ * Rebuild the interface table from a fresh dump of every link.  Any link
+ * notifications that arrive in the meantime are applied as well.  Return
+ * 1 on success, 0 on failure.
+ */
+static int
+rtnl_dump(iflist_t *iflp)
+{
+	struct {
+		struct nlmsghdr		nh;
+		struct ifinfomsg	ifi;
+	} req;
+	struct sockaddr_nl	snl;
+	struct pollfd		pfd;
+	ssize_t			len;
+	char			*buf;
+	int			done = 0;
+
+	(void) memset(&req, 0, sizeof (req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof (struct ifinfomsg));
+	req.nh.nlmsg_type = RTM_GETLINK;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.nh.nlmsg_seq = ++iflp->seq;
+	req.ifi.ifi_family = AF_UNSPEC;
+
+	(void) memset(&snl, 0, sizeof (snl));
+	snl.nl_family = AF_NETLINK;
+
+	while (sendto(iflp->fd, &req, req.nh.nlmsg_len, 0,
+	    (struct sockaddr *)&snl, sizeof (snl)) == -1) {
+		if (errno != EINTR) {
+			warn("cannot request interface list");
+			return (0);
+		}
+	}
+
+	iflp->nents = 0;
+	while (!done) {
+		len = recv(iflp->fd, iflp->buf, iflp->bufsize, MSG_TRUNC);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+
+			/*
+			 * The dump has to be read to the end no matter
+			 * what, so wait for it even if the socket is
+			 * non-blocking.
+			 */
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				pfd.fd = iflp->fd;
+				pfd.events = POLLIN;
+				(void) poll(&pfd, 1, -1);
+				continue;
+			}
+			warn("cannot read interface list");
+			return (0);
+		}
+
+		/*
+		 * If a batch didn't fit, whatever was in it is lost; throw
+		 * away the rest of the dump, grow the buffer, and go again.
+		 */
+		if ((size_t)len > iflp->bufsize) {
+			rtnl_drain(iflp);
+			buf = realloc(iflp->buf, len);
+			if (buf == NULL) {
+				warn("cannot grow interface list buffer");
+				return (0);
+			}
+			iflp->buf = buf;
+			iflp->bufsize = len;
+			return (rtnl_dump(iflp));
+		}
+
+		(void) rtnl_process(iflp, len, &done);
+	}
+
+	return (1);
+}
+
+/*
+ * Throw away whatever is left of an abandoned dump.  The kernel only
+ * produces the next part of a dump as the previous one is read, so once
+ * the socket runs dry, the dump is over.
+ */
+static void
+rtnl_drain(iflist_t *iflp)
+{
+	ssize_t	len;
+
+	do {
+		len = recv(iflp->fd, iflp->buf, iflp->bufsize, MSG_DONTWAIT);
+	} while (len > 0 || (len == -1 && errno == EINTR));
+}
+
+/*
+ * Apply the `len' bytes of rtnetlink messages in our buffer to the
+ * interface table, and set `donep' if the end of our dump was among them.
+ * Return 1 if the table changed.
+ */
+static int
+rtnl_process(iflist_t *iflp, size_t len, int *donep)
+{
+	struct nlmsghdr	*nhp = (struct nlmsghdr *)iflp->buf;
+	int		changed = 0;
+
+	*donep = 0;
+	for (; NLMSG_OK(nhp, len); nhp = NLMSG_NEXT(nhp, len)) {
+		switch (nhp->nlmsg_type) {
+		case RTM_NEWLINK:
+			changed |= rtnl_newlink(iflp, nhp);
+			break;
+
+		case RTM_DELLINK:
+			changed |= rtnl_dellink(iflp, nhp);
+			break;
+
+		case NLMSG_DONE:
+		case NLMSG_ERROR:
+			if (nhp->nlmsg_seq == iflp->seq)
+				*donep = 1;
+			break;
+		}
+	}
+
+	return (changed);
+}
+
+/*
+ * Add or update the interface described by the RTM_NEWLINK message
+ * pointed to by `nhp'.  Return 1 if the table changed.
+ */
+static int
+rtnl_newlink(iflist_t *iflp, struct nlmsghdr *nhp)
+{
+	struct ifinfomsg	*ifip = NLMSG_DATA(nhp);
+	struct rtattr		*rta = IFLA_RTA(ifip);
+	int			len = IFLA_PAYLOAD(nhp);
+	const char		*name = NULL;
+	iflent_t		*entp;
+	unsigned int		i, maxents;
+
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFLA_IFNAME) {
+			name = RTA_DATA(rta);
+			break;
+		}
+	}
+
+	if (name == NULL || strlen(name) >= IFNAMSIZ)
+		return (0);
+
+	/*
+	 * Keep the table sorted by index, which is the order the kernel
+	 * lists interfaces in.
+	 */
+	for (i = 0; i < iflp->nents; i++) {
+		if (iflp->ents[i].ifindex >= ifip->ifi_index)
+			break;
+	}
+
+	if (i < iflp->nents && iflp->ents[i].ifindex == ifip->ifi_index) {
+		entp = &iflp->ents[i];
+		if (entp->flags == (int)ifip->ifi_flags &&
+		    strcmp(entp->name, name) == 0)
+			return (0);
+	} else {
+		if (iflp->nents == iflp->maxents) {
+			maxents = (iflp->maxents == 0) ? 16 : iflp->maxents * 2;
+			entp = realloc(iflp->ents, maxents * sizeof (iflent_t));
+			if (entp == NULL) {
+				warn("cannot grow interface list");
+				return (0);
+			}
+			iflp->ents = entp;
+			iflp->maxents = maxents;
+		}
+
+		entp = &iflp->ents[i];
+		(void) memmove(entp + 1, entp,
+		    (iflp->nents - i) * sizeof (iflent_t));
+		iflp->nents++;
+		entp->ifindex = ifip->ifi_index;
+	}
+
+	(void) strcpy(entp->name, name);
+	entp->flags = ifip->ifi_flags;
+	return (1);
+}
+
+/*
+ * Remove the interface described by the RTM_DELLINK message pointed to by
+ * `nhp'.  Return 1 if the table changed.
+ */
+static int
+rtnl_dellink(iflist_t *iflp, struct nlmsghdr *nhp)
+{
+	struct ifinfomsg	*ifip = NLMSG_DATA(nhp);
+	unsigned int		i;
+
+	for (i = 0; i < iflp->nents; i++) {
+		if (iflp->ents[i].ifindex == ifip->ifi_index) {
+			(void) memmove(&iflp->ents[i], &iflp->ents[i + 1],
+			    (iflp->nents - i - 1) * sizeof (iflent_t));
+			iflp->nents--;
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Return the table entry for interface `ifname', or NULL if there isn't one.
+ */
+static iflent_t *
+rtnl_lookup(iflist_t *iflp, const char *ifname)
+{
+	unsigned int i;
+
+	for (i = 0; i < iflp->nents; i++) {
+		if (strcmp(iflp->ents[i].name, ifname) == 0)
+			return (&iflp->ents[i]);
+	}
+
+	return (NULL);
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface statistics trace recording routines, and the varint coding
+ * shared with the replay backend.  See ifrec.h for the trace format.
+ */
+
+#pragma ident "@(#)ifrec.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ifrec.h"
+#include "utils.h"
+
+struct ifrec {
+	FILE		*fp;		/* trace being written */
+	struct timeval	last;		/* timestamp of the previous record */
+	ifstatsnap_t	prev;		/* interfaces in the previous record */
+};
+
+/*
+ * Create (or truncate) the trace at `path' and return a handle for
+ * recording to it, or NULL on failure.
+ */
+ifrec_t *
+ifrec_open(const char *path)
+{
+	ifrec_t *recp;
+
+	recp = calloc(1, sizeof (ifrec_t));
+	if (recp == NULL) {
+		warn("cannot allocate trace state");
+		return (NULL);
+	}
+
+	recp->fp = fopen(path, "wb");
+	if (recp->fp == NULL) {
+		warn("cannot open trace %s", path);
+		free(recp);
+		return (NULL);
+	}
+
+	if (fwrite(WN_IFREC_MAGIC, WN_IFREC_MAGICLEN, 1, recp->fp) != 1 ||
+	    putc(WN_IFREC_VERSION, recp->fp) == EOF) {
+		warn("cannot write trace %s", path);
+		(void) fclose(recp->fp);
+		free(recp);
+		return (NULL);
+	}
+
+	return (recp);
+}
+
+/*
+ * Append a record of the snapshot pointed to by `snap', taken at time
+ * `tvp', to the trace associated with `recp'.  Return 1 on success, 0 on
+ * failure.
+ */
+int
+ifrec_write(ifrec_t *recp, const struct timeval *tvp,
+    const ifstatsnap_t *snap)
+{
+	unsigned char		buf[IFNAMSIZ + WN_IFREC_MAXVARINT *
+				    (3 + WN_IFSTATS_NCTRS)];
+	unsigned char		*cp;
+	const ifstatent_t	*entp;
+	ifstatent_t		*prevp;
+	const unsigned long long *ctrs;
+	unsigned long long	*pctrs, delta;
+	long long		usec;
+	unsigned int		i, j;
+	size_t			namelen;
+
+	if (!if_snapgrow(&recp->prev, snap->nents))
+		return (0);
+
+	usec = (long long)(tvp->tv_sec - recp->last.tv_sec) * 1000000 +
+	    (tvp->tv_usec - recp->last.tv_usec);
+	if (usec < 0)
+		usec = 0;
+
+	cp = ifrec_putvarint(buf, usec);
+	cp = ifrec_putvarint(cp, snap->nents);
+	if (fwrite(buf, cp - buf, 1, recp->fp) != 1)
+		return (0);
+
+	for (i = 0; i < snap->nents; i++) {
+		entp = &snap->ents[i];
+		prevp = &recp->prev.ents[i];
+
+		cp = buf;
+		if (i < recp->prev.nents &&
+		    strcmp(prevp->name, entp->name) == 0) {
+			cp = ifrec_putvarint(cp, 0);
+		} else {
+			namelen = strlen(entp->name);
+			cp = ifrec_putvarint(cp, namelen);
+			(void) memcpy(cp, entp->name, namelen);
+			cp += namelen;
+			(void) memset(&prevp->stats, 0, sizeof (ifstats_t));
+		}
+		cp = ifrec_putvarint(cp, entp->ifindex);
+		cp = ifrec_putvarint(cp, (unsigned int)entp->flags + 1);
+
+		/*
+		 * Counters can go backwards (e.g., if the interface is
+		 * re-created), so zigzag-encode the changes to keep small
+		 * negative ones small.
+		 */
+		ctrs = (const unsigned long long *)&entp->stats;
+		pctrs = (unsigned long long *)&prevp->stats;
+		for (j = 0; j < WN_IFSTATS_NCTRS; j++) {
+			delta = ctrs[j] - pctrs[j];
+			cp = ifrec_putvarint(cp, (delta << 1) ^ -(delta >> 63));
+		}
+
+		if (fwrite(buf, cp - buf, 1, recp->fp) != 1)
+			return (0);
+
+		*prevp = *entp;
+	}
+
+	recp->prev.nents = snap->nents;
+	recp->last = *tvp;
+
+	/*
+	 * Flush each record so that the trace is still useful if we're
+	 * killed mid-incident.
+	 */
+	return (fflush(recp->fp) == 0);
+}
+
+/*
+ * Finish the trace associated with `recp' and free its state.
+ */
+void
+ifrec_close(ifrec_t *recp)
+{
+	(void) fclose(recp->fp);
+	if_snapfree(&recp->prev);
+	free(recp);
+}
+
+/*
+ * Store `val' as a varint at `cp', and return a pointer just past it.
+ * The caller must supply WN_IFREC_MAXVARINT bytes of space.
+ */
+unsigned char *
+ifrec_putvarint(unsigned char *cp, unsigned long long val)
+{
+	while (val >= 0x80) {
+		*cp++ = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+	*cp++ = val;
+	return (cp);
+}
+
+/*
+ * Decode the varint at `cp' (which must end before `end') into `valp',
+ * and return a pointer just past it, or NULL if it's truncated or
+ * malformed.
+ */
+const unsigned char *
+ifrec_getvarint(const unsigned char *cp, const unsigned char *end,
+    unsigned long long *valp)
+{
+	unsigned long long	val = 0;
+	unsigned int		shift;
+
+	for (shift = 0; cp < end && shift < 7 * WN_IFREC_MAXVARINT;
+	    shift += 7) {
+		val |= (unsigned long long)(*cp & 0x7f) << shift;
+		if ((*cp++ & 0x80) == 0) {
+			*valp = val;
+			return (cp);
+		}
+	}
+
+	return (NULL);
+}
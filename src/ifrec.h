@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface statistics trace interfaces.  A trace is a compact log of
+ * every sample taken while recording, which the replay backend can later
+ * serve back through the ifstat.h interfaces.
+ *
+ * A trace is the four bytes "WNTR" and a version byte, followed by one
+ * record per sample.  All numbers are stored as little-endian base-128
+ * varints, and everything is stored relative to the previous record (or
+ * zero, for the first one):
+ *
+ *	varint	microseconds since the previous record's timestamp
+ *	varint	number of interfaces that follow
+ *
+ * and then, for each interface:
+ *
+ *	varint	length of its name, or 0 if it's the same as the name of
+ *		the interface in the same position in the previous record
+ *	bytes	its name, if the length is non-zero
+ *	varint	its interface index
+ *	varint	its flags plus one (so that unknown flags are 0)
+ *	varint	the zigzag-encoded change in each of its WN_IFSTATS_NCTRS
+ *		counters since the previous record, in ifstats_t order
+ *		(relative to zero if the name changed)
+ *
+ * Since most counters barely move between samples, a record usually
+ * takes a couple of bytes per counter.
+ */
+
+#ifndef	WN_IFREC_H
+#define	WN_IFREC_H
+
+#pragma ident "@(#)ifrec.h	1.1	26/10/17 meem"
+
+#include <sys/time.h>
+
+#include "ifstat.h"
+
+#define	WN_IFREC_MAGIC		"WNTR"
+#define	WN_IFREC_MAGICLEN	4
+#define	WN_IFREC_VERSION	1
+#define	WN_IFREC_HDRLEN		(WN_IFREC_MAGICLEN + 1)
+#define	WN_IFREC_MAXVARINT	10	/* longest varint, in bytes */
+
+typedef struct ifrec ifrec_t;
+
+extern ifrec_t		*ifrec_open(const char *);
+extern int		ifrec_write(ifrec_t *, const struct timeval *,
+			    const ifstatsnap_t *);
+extern void		ifrec_close(ifrec_t *);
+
+extern unsigned char	*ifrec_putvarint(unsigned char *, unsigned long long);
+extern const unsigned char *ifrec_getvarint(const unsigned char *,
+			    const unsigned char *, unsigned long long *);
+
+#endif /* WN_IFREC_H */
@@ -0,0 +1,505 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface statistics routines shared by every flavor of Unix, including
+ * the table of statistics backends that were compiled in and the
+ * routines that dispatch to them.
+ */
+
+#pragma ident "@(#)ifstat.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ifstat.h"
+#include "utils.h"
+
+#define	WN_IFSTAT_NPROBES	16	/* samples to time each backend for */
+#define	WN_IFSTAT_CTR32MAX	0xffffffffULL	/* largest 32-bit counter */
+
+struct ifstat {
+	const ifstatops_t	*ops;		/* backend operations */
+	ifstatstate_t		*statep;	/* backend state */
+	unsigned long long	stamp;		/* time of last sample, in ns */
+};
+
+/*
+ * The backends that were compiled in; the first one that works is the
+ * fallback when `auto' can't tell them apart.
+ */
+static const ifstatops_t *if_backends[] = {
+#ifdef	WN_IFSTAT_NETLINK
+	&ifstat_netlink_ops,
+#endif
+#ifdef	WN_IFSTAT_LINUX
+	&ifstat_linux_ops,
+#endif
+#ifdef	WN_IFSTAT_SYSFS
+	&ifstat_sysfs_ops,
+#endif
+#ifdef	WN_IFSTAT_FREEBSD
+	&ifstat_freebsd_ops,
+#endif
+#ifdef	WN_IFSTAT_NETBSD
+	&ifstat_netbsd_ops,
+#endif
+#ifdef	WN_IFSTAT_SOLARIS
+	&ifstat_solaris_ops,
+#endif
+#ifdef	WN_IFSTAT_REPLAY
+	&ifstat_replay_ops,
+#endif
+	NULL
+};
+
+#define	WN_IFSTAT_NBACKENDS	\
+	(sizeof (if_backends) / sizeof (if_backends[0]) - 1)
+
+static long	if_statprobe(const ifstatops_t *, const char *);
+static unsigned long long if_statnow(ifstat_t *);
+static void	if_statmark(ifstat_t *, unsigned long long);
+
+/*
+ * Return the operations for the `i'th backend that was compiled in, or
+ * NULL if there are fewer than `i' + 1 of them.
+ */
+const ifstatops_t *
+if_statbackend(unsigned int i)
+{
+	return (i < WN_IFSTAT_NBACKENDS ? if_backends[i] : NULL);
+}
+
+/*
+ * Return the operations for the backend called `name', or NULL if there
+ * is no such backend.  If `name' is "auto", then briefly time each live
+ * backend gathering stats on interface `ifname' and return the cheapest
+ * one that works.
+ */
+const ifstatops_t *
+if_statlookup(const char *name, const char *ifname)
+{
+	const ifstatops_t	*opsp, *bestopsp = NULL;
+	long			usec, bestusec = 0;
+	unsigned int		i;
+
+	if (strcmp(name, "auto") != 0) {
+		for (i = 0; if_backends[i] != NULL; i++) {
+			if (strcmp(if_backends[i]->name, name) == 0)
+				return (if_backends[i]);
+		}
+		return (NULL);
+	}
+
+	for (i = 0; (opsp = if_backends[i]) != NULL; i++) {
+		if (opsp->clock != NULL)
+			continue;
+
+		usec = if_statprobe(opsp, ifname);
+		if (usec != -1 && (bestopsp == NULL || usec < bestusec)) {
+			bestopsp = opsp;
+			bestusec = usec;
+		}
+	}
+
+	/*
+	 * If nothing could gather stats on `ifname' (maybe it doesn't exist
+	 * yet), there's nothing to compare; just use the first backend.
+	 */
+	return (bestopsp != NULL ? bestopsp : if_backends[0]);
+}
+
+/*
+ * Initialize the backend described by `opsp' and return a handle on it,
+ * or NULL on failure.
+ */
+ifstat_t *
+if_statinit(const ifstatops_t *opsp)
+{
+	ifstat_t *isp;
+
+	isp = malloc(sizeof (ifstat_t));
+	if (isp == NULL) {
+		warn("cannot allocate interface statistics handle");
+		return (NULL);
+	}
+
+	isp->ops = opsp;
+	isp->stamp = 0;
+	isp->statep = opsp->init();
+	if (isp->statep == NULL) {
+		free(isp);
+		return (NULL);
+	}
+
+	return (isp);
+}
+
+/*
+ * Retrieve stats on interface `ifname' through the backend associated
+ * with `isp', and store the statistics in `ifstatsp'.  Return 1 on
+ * success, 0 on failure.  On success, the time of the sample is
+ * available through if_statstamp().
+ */
+int
+if_stats(const char *ifname, ifstat_t *isp, ifstats_t *ifstatsp)
+{
+	unsigned long long	start;
+	int			ok;
+
+	start = if_statnow(isp);
+	ok = isp->ops->stats(ifname, isp->statep, ifstatsp);
+	if (ok)
+		if_statmark(isp, start);
+
+	return (ok);
+}
+
+/*
+ * Take a snapshot of the stats on every interface through the backend
+ * associated with `isp'.  Return NULL on failure.  On success, the time
+ * of the snapshot is available through if_statstamp().
+ */
+const ifstatsnap_t *
+if_statsall(ifstat_t *isp)
+{
+	const ifstatsnap_t	*snap;
+	unsigned long long	start;
+
+	start = if_statnow(isp);
+	snap = isp->ops->statsall(isp->statep);
+	if (snap != NULL)
+		if_statmark(isp, start);
+
+	return (snap);
+}
+
+/*
+ * Return the time, in nanoseconds, at which the last successful sample
+ * through `isp' was taken, or 0 if there hasn't been one.  Only the
+ * difference between two stamps means anything.
+ */
+unsigned long long
+if_statstamp(ifstat_t *isp)
+{
+	return (isp->stamp);
+}
+
+/*
+ * Return the interface flags that came back with the last successful
+ * call to if_stats(), or -1 if the backend doesn't know them.
+ */
+int
+if_statflags(ifstat_t *isp)
+{
+	return (isp->ops->flags(isp->statep));
+}
+
+/*
+ * Return the index of the interface that came back with the last
+ * successful call to if_stats(), or 0 if the backend doesn't know it.
+ */
+unsigned int
+if_statifindex(ifstat_t *isp)
+{
+	if (isp->ops->ifindex == NULL)
+		return (0);
+
+	return (isp->ops->ifindex(isp->statep));
+}
+
+/*
+ * Store the time of the last sample taken through `isp' in `tvp' (if it's
+ * non-NULL).  For live backends, that's just the current (monotonic, if
+ * possible) time, and 0 is returned.  Backends that replay samples keep
+ * their own clock; 1 is returned for them, or -1 once they have nothing
+ * more to replay.
+ */
+int
+if_statclock(ifstat_t *isp, struct timeval *tvp)
+{
+	struct timeval tv;
+
+	if (isp->ops->clock != NULL)
+		return (isp->ops->clock(isp->statep, tvp != NULL ? tvp : &tv));
+
+	if (tvp != NULL) {
+#ifdef	CLOCK_MONOTONIC
+		struct timespec ts;
+
+		(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+		tvp->tv_sec = ts.tv_sec;
+		tvp->tv_usec = ts.tv_nsec / 1000;
+#else
+		(void) gettimeofday(tvp, NULL);
+#endif
+	}
+	return (0);
+}
+
+/*
+ * Return the current time in nanoseconds, on the same clock as
+ * if_statclock(): the monotonic clock (if possible) for live backends,
+ * and the virtual clock for backends that replay samples.
+ */
+static unsigned long long
+if_statnow(ifstat_t *isp)
+{
+	struct timeval	tv;
+
+	if (isp->ops->clock != NULL) {
+		if (isp->ops->clock(isp->statep, &tv) != 1)
+			return (isp->stamp);
+	} else {
+#ifdef	CLOCK_MONOTONIC
+		struct timespec ts;
+
+		(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#else
+		(void) gettimeofday(&tv, NULL);
+#endif
+	}
+	return (tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL);
+}
+
+/*
+ * Record the time of the sample that was just taken through `isp', with
+ * the backend call having started at `start'.  Since a live backend reads
+ * the counters somewhere between the start and the end of the call, use
+ * the midpoint; for one that walks a large table, that halves the error.
+ * A replaying backend's clock only moves when the sample is read, so its
+ * time after the call is exact.
+ */
+static void
+if_statmark(ifstat_t *isp, unsigned long long start)
+{
+	unsigned long long end = if_statnow(isp);
+
+	if (isp->ops->clock != NULL)
+		isp->stamp = end;
+	else
+		isp->stamp = start + (end - start) / 2;
+}
+
+/*
+ * Clean up the handle pointed to by `isp' and its backend.
+ */
+void
+if_statfini(ifstat_t *isp)
+{
+	isp->ops->fini(isp->statep);
+	free(isp);
+}
+
+/*
+ * Time how long the backend described by `opsp' takes to gather
+ * WN_IFSTAT_NPROBES samples of the stats on interface `ifname', and
+ * return the result in microseconds, or -1 if it can't.  The first sample
+ * isn't counted, since it pays for any one-time lookups.
+ */
+static long
+if_statprobe(const ifstatops_t *opsp, const char *ifname)
+{
+	ifstat_t	probe;
+	ifstats_t	stats;
+	unsigned long long start;
+	unsigned int	i;
+	long		usec = -1;
+
+	if (ifname == NULL)
+		return (-1);
+
+	(void) memset(&probe, 0, sizeof (probe));
+	probe.ops = opsp;
+	probe.statep = opsp->init();
+	if (probe.statep == NULL)
+		return (-1);
+
+	if (opsp->stats(ifname, probe.statep, &stats) == 0)
+		goto out;
+
+	/*
+	 * Time it on the same clock as the samples themselves, so that the
+	 * wall clock being stepped meanwhile can't skew the choice.
+	 */
+	start = if_statnow(&probe);
+	for (i = 0; i < WN_IFSTAT_NPROBES; i++) {
+		if (opsp->stats(ifname, probe.statep, &stats) == 0)
+			goto out;
+	}
+	usec = (if_statnow(&probe) - start) / 1000;
+out:
+	opsp->fini(probe.statep);
+	return (usec);
+}
+
+/*
+ * Make sure the snapshot pointed to by `snap' has room for at least `n'
+ * entries; new entries are zeroed.  Return 1 on success, 0 on failure.
+ */
+int
+if_snapgrow(ifstatsnap_t *snap, unsigned int n)
+{
+	ifstatent_t	*entp;
+	unsigned int	maxents;
+
+	if (n <= snap->maxents)
+		return (1);
+
+	maxents = (snap->maxents == 0) ? 16 : snap->maxents;
+	while (maxents < n)
+		maxents *= 2;
+
+	entp = realloc(snap->ents, maxents * sizeof (ifstatent_t));
+	if (entp == NULL) {
+		warn("cannot grow interface statistics snapshot");
+		return (0);
+	}
+	(void) memset(&entp[snap->maxents], 0,
+	    (maxents - snap->maxents) * sizeof (ifstatent_t));
+	snap->ents = entp;
+	snap->maxents = maxents;
+	return (1);
+}
+
+/*
+ * Return a pointer to entry `i' of the snapshot pointed to by `snap',
+ * growing the snapshot if necessary, and name it `name' (which need not
+ * be NUL-terminated; its length is `namelen').  The interface index is
+ * left to the caller, since most backends learn it along with the stats;
+ * if the entry had a different name in the previous snapshot, it is
+ * reset to 0.  Return NULL on failure.
+ */
+ifstatent_t *
+if_snapent(ifstatsnap_t *snap, unsigned int i, const char *name,
+    size_t namelen)
+{
+	ifstatent_t	*entp;
+
+	if (namelen == 0 || namelen >= IFNAMSIZ)
+		return (NULL);
+
+	if (!if_snapgrow(snap, i + 1))
+		return (NULL);
+
+	entp = &snap->ents[i];
+	if (strncmp(entp->name, name, namelen) != 0 ||
+	    entp->name[namelen] != '\0') {
+		(void) memcpy(entp->name, name, namelen);
+		entp->name[namelen] = '\0';
+		entp->ifindex = 0;
+	}
+
+	return (entp);
+}
+
+/*
+ * For backends whose source doesn't carry the interface index: return 1
+ * if the index cached in `entp' has to be looked up again now that
+ * interface `name' has counters `statsp' -- that is, if the entry was
+ * for some other interface, has no index yet, or its counters were reset
+ * (as they are when the interface is re-created).  Otherwise, return 0,
+ * and the cached index still stands.
+ */
+int
+if_snapstale(const ifstatent_t *entp, const char *name,
+    const ifstats_t *statsp)
+{
+	ifstats_t	delta;
+
+	return (entp->ifindex == 0 || strcmp(entp->name, name) != 0 ||
+	    !if_statsdelta(statsp, &entp->stats, &delta));
+}
+
+/*
+ * Free the entries associated with the snapshot pointed to by `snap'.
+ */
+void
+if_snapfree(ifstatsnap_t *snap)
+{
+	free(snap->ents);
+	snap->ents = NULL;
+	snap->nents = snap->maxents = 0;
+}
+
+/*
+ * Store how much each counter went up by between the samples pointed to
+ * by `ostatsp' and `statsp' in `deltap'.  Sources that only keep 32-bit
+ * counters (older kernels, 32-bit platforms, some drivers) wrap every
+ * 4GB, so a counter that went backwards without leaving 32 bits is taken
+ * to have wrapped, provided that means it went up by less than half its
+ * range.  Anything else -- a counter going backwards that can't have
+ * wrapped, or every counter that was running going backwards at once --
+ * means the counters were reset (the driver was reset, or the interface
+ * re-created), and 0 is returned.  Otherwise, 1 is returned.
+ */
+int
+if_statsdelta(const ifstats_t *statsp, const ifstats_t *ostatsp,
+    ifstats_t *deltap)
+{
+	const unsigned long long *cp = (const unsigned long long *)statsp;
+	const unsigned long long *ocp = (const unsigned long long *)ostatsp;
+	unsigned long long	*dp = (unsigned long long *)deltap;
+	unsigned int		i, nrunning = 0, nwrapped = 0;
+
+	for (i = 0; i < WN_IFSTATS_NCTRS; i++) {
+		if (ocp[i] != 0)
+			nrunning++;
+
+		if (cp[i] >= ocp[i]) {
+			dp[i] = cp[i] - ocp[i];
+			continue;
+		}
+
+		if (ocp[i] > WN_IFSTAT_CTR32MAX || cp[i] > WN_IFSTAT_CTR32MAX)
+			return (0);
+
+		dp[i] = (cp[i] - ocp[i]) & WN_IFSTAT_CTR32MAX;
+		if (dp[i] > WN_IFSTAT_CTR32MAX / 2)
+			return (0);
+		nwrapped++;
+	}
+
+	return (nwrapped < nrunning || nwrapped == 0);
+}
+
+/*
+ * Store the per-second rate of change of each counter between the
+ * samples pointed to by `ostatsp' and `statsp', taken `nsec' nanoseconds
+ * apart, into `ratep'.  If no time passed at all, the rates are zero.
+ */
+void
+if_statsrate(const ifstats_t *statsp, const ifstats_t *ostatsp,
+    unsigned long long nsec, ifrates_t *ratep)
+{
+	const unsigned long long *cp = (const unsigned long long *)statsp;
+	const unsigned long long *ocp = (const unsigned long long *)ostatsp;
+	double			*rp = (double *)ratep;
+	double			persec;
+	unsigned int		i;
+
+	persec = (nsec != 0) ? 1e9 / nsec : 0.0;
+	for (i = 0; i < WN_IFSTATS_NCTRS; i++)
+		rp[i] = (double)(cp[i] - ocp[i]) * persec;
+}
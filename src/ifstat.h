@@ -18,8 +18,9 @@
  * wmnetload - A dockapp to monitor network interface usage.
  *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
  *
- * Network statistics interfaces -- to be implemented by each flavor
- * of Unix that wmnetload runs on.
+ * Network statistics interfaces.  Each statistics source (usually one
+ * per flavor of Unix, though Linux has several) implements the backend
+ * operations below; the if_stat*() routines dispatch to one of them.
  */
 
 #ifndef	WN_IFSTAT_H
@@ -27,23 +28,136 @@
 
 #pragma ident "@(#)ifstat.h	1.1	02/01/09 meem"
 
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <net/if.h>
+
 /*
- * For now, we only keep two network statistics -- maybe we'll keep more in
- * the future.
+ * The network statistics we keep.  Every flavor of Unix reports these
+ * along with the byte counts, so they are gathered in the same pass; any
+ * that a given flavor doesn't know about are left at zero.
  */
 typedef struct {
 	unsigned long long	rxbytes;	/* received byte count */
 	unsigned long long	txbytes;	/* transmitted byte count */
+	unsigned long long	rxpackets;	/* received packet count */
+	unsigned long long	txpackets;	/* transmitted packet count */
+	unsigned long long	rxerrors;	/* receive error count */
+	unsigned long long	txerrors;	/* transmit error count */
+	unsigned long long	rxdrops;	/* received packets dropped */
+	unsigned long long	txdrops;	/* transmit packets dropped */
+	unsigned long long	rxfifo;		/* receive FIFO overruns */
+	unsigned long long	txfifo;		/* transmit FIFO underruns */
+	unsigned long long	multicast;	/* received multicast packets */
 } ifstats_t;
 
 /*
- * Each network statistics implementation must define its own version of
- * this structure.
+ * Since every statistic is a counter of the same type, an ifstats_t can
+ * also be walked as an array of WN_IFSTATS_NCTRS counters.
+ */
+#define	WN_IFSTATS_NCTRS	\
+	(sizeof (ifstats_t) / sizeof (unsigned long long))
+
+/*
+ * The per-second rates of change of the statistics above, in the same
+ * order, so that an ifrates_t can likewise be walked as an array of
+ * WN_IFSTATS_NCTRS doubles.  Rates are kept in floating point so that
+ * slow counters (and short intervals) don't get truncated to zero.
+ */
+typedef struct {
+	double	rxbytes;		/* received bytes/sec */
+	double	txbytes;		/* transmitted bytes/sec */
+	double	rxpackets;		/* received packets/sec */
+	double	txpackets;		/* transmitted packets/sec */
+	double	rxerrors;		/* receive errors/sec */
+	double	txerrors;		/* transmit errors/sec */
+	double	rxdrops;		/* received packets dropped/sec */
+	double	txdrops;		/* transmit packets dropped/sec */
+	double	rxfifo;			/* receive FIFO overruns/sec */
+	double	txfifo;			/* transmit FIFO underruns/sec */
+	double	multicast;		/* received multicast/sec */
+} ifrates_t;
+
+/*
+ * A consistent snapshot of the statistics for every interface on the
+ * system, as returned by if_statsall().  The snapshot belongs to the
+ * ifstat_t it was taken from and is only valid until the next call.
+ */
+typedef struct {
+	char		name[IFNAMSIZ];	/* interface name */
+	unsigned int	ifindex;	/* interface index (0 if unknown) */
+	int		flags;		/* interface flags (-1 if unknown) */
+	ifstats_t	stats;		/* interface statistics */
+} ifstatent_t;
+
+typedef struct {
+	ifstatent_t	*ents;		/* one entry per interface */
+	unsigned int	nents;		/* number of entries in use */
+	unsigned int	maxents;	/* number of entries allocated */
+} ifstatsnap_t;
+
+/*
+ * Each network statistics backend must define its own version of this
+ * structure, and fill out an ifstatops_t describing its operations.
+ * Backends that serve samples from somewhere other than the live system
+ * also provide a `clock' operation, which stores the time of the last
+ * sample served and returns 1, or returns -1 once there are no more.
+ * The `ifindex' operation returns the index of the interface as of the
+ * last successful call to `stats' (or 0 if there wasn't one), so that an
+ * interface re-created under the same name can be told apart.  Backends
+ * whose source doesn't carry the index cache it, and only look it up
+ * again when if_snapstale() says to.
  */
 typedef struct ifstatstate ifstatstate_t;
 
-extern ifstatstate_t	*if_statinit(void);
-extern int		if_stats(const char *, ifstatstate_t *, ifstats_t *);
-extern void		if_statfini(ifstatstate_t *);
+typedef struct {
+	const char	*name;		/* name used to select the backend */
+	ifstatstate_t	*(*init)(void);
+	int		(*stats)(const char *, ifstatstate_t *, ifstats_t *);
+	const ifstatsnap_t *(*statsall)(ifstatstate_t *);
+	int		(*flags)(ifstatstate_t *);
+	void		(*fini)(ifstatstate_t *);
+	int		(*clock)(ifstatstate_t *, struct timeval *);
+	unsigned int	(*ifindex)(ifstatstate_t *);
+} ifstatops_t;
+
+extern const ifstatops_t ifstat_linux_ops;	/* /proc/net/dev */
+extern const ifstatops_t ifstat_netlink_ops;	/* rtnetlink */
+extern const ifstatops_t ifstat_sysfs_ops;	/* /sys/class/net */
+extern const ifstatops_t ifstat_freebsd_ops;	/* interface MIB */
+extern const ifstatops_t ifstat_netbsd_ops;	/* kvm */
+extern const ifstatops_t ifstat_solaris_ops;	/* kstat */
+extern const ifstatops_t ifstat_replay_ops;	/* recorded trace */
+
+/*
+ * A handle on an initialized backend.
+ */
+typedef struct ifstat ifstat_t;
+
+extern const ifstatops_t *if_statbackend(unsigned int);
+extern const ifstatops_t *if_statlookup(const char *, const char *);
+extern ifstat_t		*if_statinit(const ifstatops_t *);
+extern int		if_stats(const char *, ifstat_t *, ifstats_t *);
+extern const ifstatsnap_t *if_statsall(ifstat_t *);
+extern int		if_statflags(ifstat_t *);
+extern unsigned int	if_statifindex(ifstat_t *);
+extern void		if_statfini(ifstat_t *);
+extern int		if_statclock(ifstat_t *, struct timeval *);
+extern unsigned long long if_statstamp(ifstat_t *);
+
+/*
+ * Snapshot helpers shared by the implementations.
+ */
+extern int		if_snapgrow(ifstatsnap_t *, unsigned int);
+extern ifstatent_t	*if_snapent(ifstatsnap_t *, unsigned int, const char *,
+			    size_t);
+extern int		if_snapstale(const ifstatent_t *, const char *,
+			    const ifstats_t *);
+extern void		if_snapfree(ifstatsnap_t *);
+extern int		if_statsdelta(const ifstats_t *, const ifstats_t *,
+			    ifstats_t *);
+extern void		if_statsrate(const ifstats_t *, const ifstats_t *,
+			    unsigned long long, ifrates_t *);
 
 #endif /* WN_IFSTAT_H */
@@ -39,6 +39,21 @@
 
 struct ifstatstate {
 	int		ifindex;	/* cached row index of the interface */
+	int		flags;		/* flags from last if_stats(), or -1 */
+	ifstatsnap_t	snap;		/* last if_statsall() snapshot */
+};
+
+static ifstatstate_t *mib_init(void);
+static int	mib_stats(const char *, ifstatstate_t *, ifstats_t *);
+static const ifstatsnap_t *mib_statsall(ifstatstate_t *);
+static int	mib_flags(ifstatstate_t *);
+static unsigned int mib_ifindex(ifstatstate_t *);
+static void	mib_fini(ifstatstate_t *);
+static void	ifmd_stats(const struct ifmibdata *, ifstats_t *);
+
+const ifstatops_t ifstat_freebsd_ops = {
+	"freebsd", mib_init, mib_stats, mib_statsall, mib_flags, mib_fini,
+	NULL, mib_ifindex
 };
 
 /*
@@ -46,18 +61,19 @@ struct ifstatstate {
  * the gathered information in an interface statistics state structure.
  * Return the state structure.
  */
-ifstatstate_t *
-if_statinit(void)
+static ifstatstate_t *
+mib_init(void)
 {
 	ifstatstate_t   *statep;
 
-	statep = malloc(sizeof (ifstatstate_t));
+	statep = calloc(1, sizeof (ifstatstate_t));
 	if (statep == NULL) {
 		warn("cannot allocate interface statistics state");
 		return (NULL);
 	}
 
 	statep->ifindex = 1;	/* just a guess */
+	statep->flags = -1;
 	return (statep);
 }
 
@@ -65,8 +81,8 @@ if_statinit(void)
  * Optionally using state stored in `statep', retrieve stats on interface
  * `ifname', and store the statistics in `ifstatsp'.
  */
-int
-if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
+static int
+mib_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 {
 	int row;
 	int name[6] = { CTL_NET, PF_LINK, NETLINK_GENERIC, IFMIB_IFDATA };
@@ -75,6 +91,7 @@ if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 
 	name[4] = statep->ifindex;
 	name[5] = IFDATA_GENERAL;
+	statep->flags = -1;
 
 	len = sizeof (ifmd);
 	if ((sysctl(name, 6, &ifmd, &len, NULL, 0) == -1) ||
@@ -104,16 +121,107 @@ if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 		return (0);
 	}
 done:
-	ifstatsp->rxbytes = ifmd.ifmd_data.ifi_ibytes;
-	ifstatsp->txbytes = ifmd.ifmd_data.ifi_obytes;
+	ifmd_stats(&ifmd, ifstatsp);
+	statep->flags = ifmd.ifmd_flags;
 	return (1);
 }
 
+/*
+ * Return the interface flags that came back with the last successful
+ * call to if_stats(), or -1 if there weren't any.
+ */
+static int
+mib_flags(ifstatstate_t *statep)
+{
+	return (statep->flags);
+}
+
+/*
+ * Return the interface index that came back with the last successful
+ * call to if_stats(), or 0 if there wasn't one.  The MIB row is the
+ * interface index.
+ */
+static unsigned int
+mib_ifindex(ifstatstate_t *statep)
+{
+	return (statep->flags == -1 ? 0 : statep->ifindex);
+}
+
+/*
+ * Using state stored in `statep', take a snapshot of the stats on every
+ * interface by walking the interface MIB rows.  Return NULL on failure.
+ */
+static const ifstatsnap_t *
+mib_statsall(ifstatstate_t *statep)
+{
+	int name[6] = { CTL_NET, PF_LINK, NETLINK_GENERIC, IFMIB_IFDATA };
+	int ifcount;
+	size_t len;
+	struct ifmibdata ifmd;
+	ifstatsnap_t *snap = &statep->snap;
+	ifstatent_t *entp;
+
+	len = sizeof (ifcount);
+	if (sysctlbyname("net.link.generic.system.ifcount", &ifcount,
+	    &len, NULL, 0) == -1) {
+		warn("cannot retrieve the interface count");
+		return (NULL);
+	}
+
+	name[5] = IFDATA_GENERAL;
+	snap->nents = 0;
+	for (name[4] = 1; name[4] <= ifcount; name[4]++) {
+		len = sizeof (ifmd);
+		if (sysctl(name, 6, &ifmd, &len, NULL, 0) == -1)
+			continue;
+
+		entp = if_snapent(snap, snap->nents, ifmd.ifmd_name,
+		    strlen(ifmd.ifmd_name));
+		if (entp == NULL)
+			continue;
+
+		/*
+		 * The MIB row is the interface index, so there's no need
+		 * to look it up.
+		 */
+		entp->ifindex = name[4];
+		entp->flags = ifmd.ifmd_flags;
+		ifmd_stats(&ifmd, &entp->stats);
+		snap->nents++;
+	}
+
+	return (snap);
+}
+
 /*
  * Clean up the interface state structure pointed to by `statep'.
  */
-void
-if_statfini(ifstatstate_t *statep)
+static void
+mib_fini(ifstatstate_t *statep)
 {
+	if_snapfree(&statep->snap);
 	free(statep);
 }
+
+/*
+ * Copy the counters we keep out of the interface MIB row pointed to by
+ * `ifmdp' into `ifstatsp'.  The interface MIB doesn't track FIFO errors,
+ * and transmit drops are counted against the send queue.
+ */
+static void
+ifmd_stats(const struct ifmibdata *ifmdp, ifstats_t *ifstatsp)
+{
+	const struct if_data *ifdp = &ifmdp->ifmd_data;
+
+	ifstatsp->rxbytes = ifdp->ifi_ibytes;
+	ifstatsp->txbytes = ifdp->ifi_obytes;
+	ifstatsp->rxpackets = ifdp->ifi_ipackets;
+	ifstatsp->txpackets = ifdp->ifi_opackets;
+	ifstatsp->rxerrors = ifdp->ifi_ierrors;
+	ifstatsp->txerrors = ifdp->ifi_oerrors;
+	ifstatsp->rxdrops = ifdp->ifi_iqdrops;
+	ifstatsp->txdrops = ifmdp->ifmd_snd_drops;
+	ifstatsp->rxfifo = 0;
+	ifstatsp->txfifo = 0;
+	ifstatsp->multicast = ifdp->ifi_imcasts;
+}
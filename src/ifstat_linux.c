@@ -25,19 +25,77 @@
 
 #include <config.h>
 #include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "ifstat.h"
 #include "utils.h"
 
-#define	WN_PND_MAX	1024		/* see rant below */
+/*
+ * The path can be overridden through the environment so that this can be
+ * run (or timed) against a fixture rather than the live system.
+ */
+#define	WN_PND_PATH	"/proc/net/dev"
+#define	WN_PND_ENV	"WMNETLOAD_PROCNETDEV"
+#define	WN_PND_MINBUF	4096		/* initial size of the read buffer */
+#define	WN_PND_MAXCOLS	32		/* most columns we'll map */
+#define	WN_PND_NOCOL	(-1)		/* column we don't keep */
+
+/*
+ * The column headers we know how to map onto an ifstats_t, along with
+ * where each one goes in the "receive" and "transmit" halves of a line.
+ */
+static const struct {
+	const char	*name;
+	int		rxoff;
+	int		txoff;
+} pnd_cols[] = {
+	{ "bytes", offsetof(ifstats_t, rxbytes), offsetof(ifstats_t, txbytes) },
+	{ "packets", offsetof(ifstats_t, rxpackets),
+	    offsetof(ifstats_t, txpackets) },
+	{ "errs", offsetof(ifstats_t, rxerrors),
+	    offsetof(ifstats_t, txerrors) },
+	{ "drop", offsetof(ifstats_t, rxdrops), offsetof(ifstats_t, txdrops) },
+	{ "fifo", offsetof(ifstats_t, rxfifo), offsetof(ifstats_t, txfifo) },
+	{ "multicast", offsetof(ifstats_t, multicast), WN_PND_NOCOL }
+};
+
+#define	WN_PND_NKNOWN	(sizeof (pnd_cols) / sizeof (pnd_cols[0]))
 
 struct ifstatstate {
-	int		rbindex;	/* receive byte count index */
-	int		tbindex;	/* transmit byte count index */
-	FILE		*fp;
+	int		colmap[WN_PND_MAXCOLS];	/* column -> ifstats_t offset */
+	unsigned int	lastcol;	/* last column in `colmap' we keep */
+	int		fd;		/* descriptor open on WN_PND_PATH */
+	char		*buf;		/* last snapshot of WN_PND_PATH */
+	size_t		bufsize;	/* allocated size of `buf' */
+	int		sock;		/* socket for SIOCGIFINDEX, or -1 */
+	unsigned int	ifindex;	/* index from last if_stats(), or 0 */
+	ifstatent_t	last;		/* interface of last if_stats() */
+	ifstatsnap_t	snap;		/* last if_statsall() snapshot */
+};
+
+static ifstatstate_t *pnd_init(void);
+static int	pnd_stats(const char *, ifstatstate_t *, ifstats_t *);
+static const ifstatsnap_t *pnd_statsall(ifstatstate_t *);
+static int	pnd_flags(ifstatstate_t *);
+static unsigned int pnd_ifindex(ifstatstate_t *);
+static void	pnd_fini(ifstatstate_t *);
+static char	*pnd_read(ifstatstate_t *, size_t *);
+static char	*pnd_nextline(char *);
+static int	pnd_parseline(ifstatstate_t *, const char *, ifstats_t *);
+static unsigned long long pnd_atoull(const char **);
+static unsigned int pnd_nametoindex(ifstatstate_t *, const char *);
+
+const ifstatops_t ifstat_linux_ops = {
+	"linux", pnd_init, pnd_stats, pnd_statsall, pnd_flags, pnd_fini,
+	NULL, pnd_ifindex
 };
 
 /*
@@ -45,16 +103,19 @@ struct ifstatstate {
  * the gathered information in an interface statistics state structure.
  * Return the state structure.
  */
-ifstatstate_t *
-if_statinit(void)
+static ifstatstate_t *
+pnd_init(void)
 {
-	char		line[WN_PND_MAX];
 	const char	*seps = " :\t|";
+	const char	*path;
+	char		*line, *next;
 	char		*token;
-	unsigned int	i;
+	unsigned int	i, j;
+	int		off, ntx = 0, nbytes = 0;
+	size_t		len;
 	ifstatstate_t	*statep;
 
-	statep = malloc(sizeof (ifstatstate_t));
+	statep = calloc(1, sizeof (ifstatstate_t));
 	if (statep == NULL) {
 		warn("cannot allocate interface statistics state");
 		return (NULL);
@@ -63,54 +124,92 @@ if_statinit(void)
 	/*
 	 * This has to be one of the most vile interfaces ever conceived.
 	 * In a word: pathetic.  The Linux community should be ashamed.
+	 *
+	 * To keep the cost of this misery down, we hold the file open for
+	 * the life of the state structure and slurp the whole thing in with
+	 * pread()s into a buffer we keep each time we need a snapshot.
 	 */
-	statep->fp = fopen("/proc/net/dev", "r");
-	if (statep->fp == NULL)
+	path = getenv(WN_PND_ENV);
+	if (path == NULL)
+		path = WN_PND_PATH;
+
+	statep->fd = open(path, O_RDONLY);
+	if (statep->fd == -1)
 		goto openfail;
 
-	statep->rbindex = -1;
-	statep->tbindex = -1;
+	statep->bufsize = WN_PND_MINBUF;
+	statep->buf = malloc(statep->bufsize);
+	if (statep->buf == NULL) {
+		warn("cannot allocate interface statistics buffer");
+		(void) close(statep->fd);
+		free(statep);
+		return (NULL);
+	}
+
+	for (i = 0; i < WN_PND_MAXCOLS; i++)
+		statep->colmap[i] = WN_PND_NOCOL;
 
 	/*
-	 * Find the line with the column headers.
+	 * /proc/net/dev doesn't carry the interface index, so when we need
+	 * it we ask on a socket of our own; without one, we fall back on
+	 * if_nametoindex(), which opens (and closes) one every time.
 	 */
-	for (;;) {
-		if (fgets(line, sizeof (line), statep->fp) == NULL)
-			goto parsefail;
+	statep->sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	line = pnd_read(statep, &len);
+	if (line == NULL)
+		goto parsefail;
 
+	/*
+	 * Find the line with the column headers.
+	 */
+	for (; *line != '\0'; line = next) {
+		next = pnd_nextline(line);
 		if (strstr(line, "bytes") != NULL)
 			break;
 	}
 
 	/*
 	 * Figure out which columns are associated with which statistics;
-	 * blithely assume that "receive" is before "transmit".
+	 * blithely assume that "receive" is before "transmit", and that
+	 * the second "bytes" column is where "transmit" starts.
 	 */
 	token = strtok(line, seps);
-	for (i = 0; token != NULL; i++) {
-		if (strcmp(token, "bytes") == 0) {
-			if (statep->rbindex == -1)
-				statep->rbindex = i;
-			else
-				statep->tbindex = i;
+	for (i = 0; token != NULL && i < WN_PND_MAXCOLS; i++) {
+		if (strcmp(token, "bytes") == 0)
+			ntx = nbytes++;
+
+		for (j = 0; j < WN_PND_NKNOWN; j++) {
+			if (strcmp(token, pnd_cols[j].name) != 0)
+				continue;
+
+			off = ntx ? pnd_cols[j].txoff : pnd_cols[j].rxoff;
+			if (off != WN_PND_NOCOL) {
+				statep->colmap[i] = off;
+				statep->lastcol = i;
+			}
+			break;
 		}
 		token = strtok(NULL, seps);
 	}
 
-	if (statep->rbindex == -1 || statep->tbindex == -1)
+	if (nbytes != 2)
 		goto parsefail;
 
 	return (statep);
 
 openfail:
 	free(statep);
-	warn("cannot open /proc/net/dev; no stats will be available\n");
+	warn("cannot open %s; no stats will be available\n", path);
 	return (NULL);
 
 parsefail:
-	(void) fclose(statep->fp);
+	(void) close(statep->fd);
+	if (statep->sock != -1)
+		(void) close(statep->sock);
+	free(statep->buf);
 	free(statep);
-	warn("cannot parse /proc/net/dev; no stats will be available\n");
+	warn("cannot parse %s; no stats will be available\n", path);
 	return (NULL);
 }
 
@@ -118,51 +217,285 @@ parsefail:
  * Optionally using state stored in `statep', retrieve stats on interface
  * `ifname', and store the statistics in `ifstatsp'.
  */
-int
-if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
+static int
+pnd_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 {
-	char		line[WN_PND_MAX];
-	const char	*seps = " :\t|";
-	char		*token;
-	unsigned int	i;
+	size_t		namelen = strlen(ifname);
+	size_t		len;
+	const char	*cp, *end;
+	ifstatent_t	*lastp;
 
-	statep->fp = freopen("/proc/net/dev", "r", statep->fp);
-	if (statep->fp == NULL)
+	statep->ifindex = 0;
+	cp = pnd_read(statep, &len);
+	if (cp == NULL)
 		return (0);
+	end = cp + len;
 
-	do {
-		if (fgets(line, sizeof (line), statep->fp) == NULL)
-			return (0);
+	/*
+	 * Find the line for `ifname'.  Each one looks like "  eth0: 1 2 3";
+	 * there's no need to look past the name until we've found the
+	 * right one, so just hop from newline to newline.
+	 */
+	for (;;) {
+		while (*cp == ' ')
+			cp++;
+
+		if (*cp == *ifname && strncmp(cp, ifname, namelen) == 0 &&
+		    cp[namelen] == ':')
+			break;
 
-		token = strtok(line, seps);
-		if (token == NULL)
+		cp = memchr(cp, '\n', end - cp);
+		if (cp == NULL)
 			return (0);
-	} while (strcmp(token, ifname) != 0);
+		cp++;
+	}
 
-	/*
-	 * Found the right line; just read in the stats.
-	 */
-	for (i = 1; token != NULL; i++) {
-		token = strtok(NULL, seps);
+	if (!pnd_parseline(statep, cp + namelen + 1, ifstatsp))
+		return (0);
+
+	lastp = &statep->last;
+	if (if_snapstale(lastp, ifname, ifstatsp)) {
+		(void) strncpy(lastp->name, ifname, IFNAMSIZ - 1);
+		lastp->ifindex = pnd_nametoindex(statep, ifname);
+	}
+	lastp->stats = *ifstatsp;
+	statep->ifindex = lastp->ifindex;
+	return (1);
+}
+
+/*
+ * Return the interface flags that came back with the last successful
+ * call to if_stats(), or -1 if there weren't any.  There never are,
+ * since /proc/net/dev doesn't know them.
+ */
+/* ARGSUSED */
+static int
+pnd_flags(ifstatstate_t *statep)
+{
+	return (-1);
+}
+
+/*
+ * Return the interface index that came back with the last successful
+ * call to if_stats(), or 0 if there wasn't one.
+ */
+static unsigned int
+pnd_ifindex(ifstatstate_t *statep)
+{
+	return (statep->ifindex);
+}
+
+/*
+ * Using state stored in `statep', take a snapshot of the stats on every
+ * interface from a single read of WN_PND_PATH.  Return NULL on failure.
+ */
+static const ifstatsnap_t *
+pnd_statsall(ifstatstate_t *statep)
+{
+	ifstatsnap_t	*snap = &statep->snap;
+	ifstatent_t	*entp;
+	ifstats_t	stats;
+	size_t		len;
+	const char	*cp, *end, *eol, *colon;
+
+	cp = pnd_read(statep, &len);
+	if (cp == NULL)
+		return (NULL);
+	end = cp + len;
+
+	snap->nents = 0;
+	for (; cp < end; cp = eol + 1) {
+		eol = memchr(cp, '\n', end - cp);
+		if (eol == NULL)
+			eol = end;
 
-		if (i == statep->rbindex)
-			ifstatsp->rxbytes = strtoll(token, NULL, 0);
-		else if (i == statep->tbindex)
-			ifstatsp->txbytes = strtoll(token, NULL, 0);
+		/*
+		 * Skip anything that isn't an interface line -- i.e., the
+		 * two lines of column headers.
+		 */
+		while (*cp == ' ')
+			cp++;
+		colon = memchr(cp, ':', eol - cp);
+		if (colon == NULL)
+			continue;
 
-		if (i >= statep->rbindex && i >= statep->tbindex)
-			return (1);
+		entp = if_snapent(snap, snap->nents, cp, colon - cp);
+		if (entp == NULL)
+			continue;
+
+		if (pnd_parseline(statep, colon + 1, &stats)) {
+			if (if_snapstale(entp, entp->name, &stats))
+				entp->ifindex = pnd_nametoindex(statep,
+				    entp->name);
+			entp->stats = stats;
+			entp->flags = -1;
+			snap->nents++;
+		}
 	}
 
-	return (0);
+	return (snap);
 }
 
 /*
  * Clean up the interface state structure pointed to by `statep'.
  */
-void
-if_statfini(ifstatstate_t *statep)
+static void
+pnd_fini(ifstatstate_t *statep)
 {
-	(void) fclose(statep->fp);
+	(void) close(statep->fd);
+	if (statep->sock != -1)
+		(void) close(statep->sock);
+	free(statep->buf);
+	if_snapfree(&statep->snap);
 	free(statep);
 }
+
+/*
+ * Read the current contents of WN_PND_PATH into the buffer associated with
+ * `statep', growing it as necessary.  Return a pointer to the
+ * NUL-terminated contents and store its length in `lenp', or return NULL
+ * on failure.
+ */
+static char *
+pnd_read(ifstatstate_t *statep, size_t *lenp)
+{
+	size_t	off = 0;
+	ssize_t	len;
+	char	*buf;
+
+	/*
+	 * One pread() at offset zero would be cheapest, but procfs hands
+	 * back at most a page or so per read no matter how big the buffer
+	 * is, so a short read doesn't mean we've got it all: keep reading
+	 * from where the last read left off until we hit the end.
+	 */
+	for (;;) {
+		if (off == statep->bufsize - 1) {
+			buf = realloc(statep->buf, statep->bufsize * 2);
+			if (buf == NULL) {
+				warn("cannot grow interface statistics buffer");
+				return (NULL);
+			}
+			statep->buf = buf;
+			statep->bufsize *= 2;
+		}
+
+		len = pread(statep->fd, statep->buf + off,
+		    statep->bufsize - 1 - off, off);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			return (NULL);
+		}
+		if (len == 0)
+			break;
+		off += len;
+	}
+
+	statep->buf[off] = '\0';
+	*lenp = off;
+	return (statep->buf);
+}
+
+/*
+ * Terminate the line starting at `line' and return a pointer to the start
+ * of the next one (which is the empty string at the end of the buffer).
+ */
+static char *
+pnd_nextline(char *line)
+{
+	char *eol = strchr(line, '\n');
+
+	if (eol == NULL)
+		return (line + strlen(line));
+
+	*eol = '\0';
+	return (eol + 1);
+}
+
+/*
+ * Parse the counters on the line starting just past the interface name
+ * at `cp', storing the ones named by the column map in `statep' into
+ * `ifstatsp'.  Return 1 on success, 0 if the line is short or garbled.
+ *
+ * This is the hot loop on hosts with thousands of interfaces, so it
+ * makes a single pass: columns we don't care about are skipped without
+ * being converted, and the ones we do are converted in place.
+ */
+static int
+pnd_parseline(ifstatstate_t *statep, const char *cp, ifstats_t *ifstatsp)
+{
+	unsigned int	col, lastcol = statep->lastcol;
+	int		off;
+
+	(void) memset(ifstatsp, 0, sizeof (ifstats_t));
+
+	/*
+	 * Column 0 is the interface name, so the first counter is column 1.
+	 */
+	for (col = 1; col <= lastcol; col++) {
+		while (*cp == ' ' || *cp == '\t')
+			cp++;
+
+		off = statep->colmap[col];
+		if (off != WN_PND_NOCOL) {
+			*(unsigned long long *)((char *)ifstatsp + off) =
+			    pnd_atoull(&cp);
+		} else {
+			while ((unsigned char)(*cp - '0') <= 9)
+				cp++;
+		}
+
+		/*
+		 * Every counter must be followed by whitespace or the end
+		 * of the line; anything else means the line is garbled.
+		 */
+		if (*cp != ' ' && *cp != '\t' &&
+		    (col != lastcol || (*cp != '\n' && *cp != '\0')))
+			return (0);
+	}
+
+	return (1);
+}
+
+/*
+ * Convert the run of decimal digits at `*cpp' and advance `*cpp' past it.
+ * The kernel never pads its counters or gives them a sign, so unlike
+ * strtoull() there's no need to worry about any of that.
+ */
+static unsigned long long
+pnd_atoull(const char **cpp)
+{
+	const char		*cp = *cpp;
+	unsigned long long	val = 0;
+	unsigned int		digit;
+
+	while ((digit = (unsigned char)*cp - '0') <= 9) {
+		val = val * 10 + digit;
+		cp++;
+	}
+
+	*cpp = cp;
+	return (val);
+}
+
+/*
+ * Look up the index of interface `ifname', or return 0 if there's no such
+ * interface.  This costs a system call, so the callers only come here
+ * when if_snapstale() says their cached index won't do.
+ */
+static unsigned int
+pnd_nametoindex(ifstatstate_t *statep, const char *ifname)
+{
+	struct ifreq	ifr;
+
+	if (statep->sock == -1)
+		return (if_nametoindex(ifname));
+
+	(void) memset(&ifr, 0, sizeof (ifr));
+	(void) strncpy(ifr.ifr_name, ifname, sizeof (ifr.ifr_name) - 1);
+	if (ioctl(statep->sock, SIOCGIFINDEX, &ifr) == -1)
+		return (0);
+
+	return (ifr.ifr_ifindex);
+}
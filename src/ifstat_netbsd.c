@@ -38,8 +38,24 @@
 #include "utils.h"
 
 struct ifstatstate {
-	void	*ifnet_head;
-	kvm_t	*kd;
+	void		*ifnet_head;
+	kvm_t		*kd;
+	int		flags;		/* flags from last if_stats(), or -1 */
+	unsigned int	ifindex;	/* index from last if_stats(), or 0 */
+	ifstatsnap_t	snap;		/* last if_statsall() snapshot */
+};
+
+static ifstatstate_t *knet_init(void);
+static int	knet_stats(const char *, ifstatstate_t *, ifstats_t *);
+static const ifstatsnap_t *knet_statsall(ifstatstate_t *);
+static int	knet_flags(ifstatstate_t *);
+static unsigned int knet_ifindex(ifstatstate_t *);
+static void	knet_fini(ifstatstate_t *);
+static void	ifnet_stats(const struct ifnet *, ifstats_t *);
+
+const ifstatops_t ifstat_netbsd_ops = {
+	"netbsd", knet_init, knet_stats, knet_statsall, knet_flags, knet_fini,
+	NULL, knet_ifindex
 };
 
 /*
@@ -47,14 +63,14 @@ struct ifstatstate {
  * the gathered information in an interface statistics state structure.
  * Return the state structure.
  */
-ifstatstate_t *
-if_statinit(void)
+static ifstatstate_t *
+knet_init(void)
 {
 	ifstatstate_t	*statep;
 	struct nlist	ifnet[] = { { "_ifnet" }, { NULL }};
 	char		errbuf[_POSIX2_LINE_MAX];
 
-	statep = malloc(sizeof (ifstatstate_t));
+	statep = calloc(1, sizeof (ifstatstate_t));
 	if (statep == NULL) {
 		warn("cannot allocate interface statistics state");
 		return (NULL);
@@ -86,6 +102,7 @@ if_statinit(void)
 		goto fail;
 	}
 
+	statep->flags = -1;
 	return (statep);
 fail:
 	(void) kvm_close(statep->kd);
@@ -97,12 +114,14 @@ fail:
  * Optionally using state stored in `statep', retrieve stats on interface
  * `ifname', and store the statistics in `ifstatsp'.
  */
-int
-if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
+static int
+knet_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 {
 	void		*ifnet_addr = statep->ifnet_head;
 	struct ifnet	ifnet;
 
+	statep->flags = -1;
+	statep->ifindex = 0;
 	for (; ifnet_addr != NULL; ifnet_addr = TAILQ_NEXT(&ifnet, if_list)) {
 
 		if (kvm_read(statep->kd, (unsigned long)ifnet_addr, &ifnet,
@@ -110,8 +129,9 @@ if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 			return (0);
 
 		if (strcmp(ifnet.if_xname, ifname) == 0) {
-			ifstatsp->rxbytes = ifnet.if_ibytes;
-			ifstatsp->txbytes = ifnet.if_obytes;
+			ifnet_stats(&ifnet, ifstatsp);
+			statep->flags = ifnet.if_flags;
+			statep->ifindex = ifnet.if_index;
 			return (1);
 		}
 	}
@@ -119,12 +139,88 @@ if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 	return (0);
 }
 
+/*
+ * Return the interface flags that came back with the last successful
+ * call to if_stats(), or -1 if there weren't any.
+ */
+static int
+knet_flags(ifstatstate_t *statep)
+{
+	return (statep->flags);
+}
+
+/*
+ * Return the interface index that came back with the last successful
+ * call to if_stats(), or 0 if there wasn't one.
+ */
+static unsigned int
+knet_ifindex(ifstatstate_t *statep)
+{
+	return (statep->ifindex);
+}
+
+/*
+ * Using state stored in `statep', take a snapshot of the stats on every
+ * interface in a single walk of the kernel's ifnet list.  Return NULL on
+ * failure.
+ */
+static const ifstatsnap_t *
+knet_statsall(ifstatstate_t *statep)
+{
+	void		*ifnet_addr = statep->ifnet_head;
+	struct ifnet	ifnet;
+	ifstatsnap_t	*snap = &statep->snap;
+	ifstatent_t	*entp;
+
+	snap->nents = 0;
+	for (; ifnet_addr != NULL; ifnet_addr = TAILQ_NEXT(&ifnet, if_list)) {
+
+		if (kvm_read(statep->kd, (unsigned long)ifnet_addr, &ifnet,
+		    sizeof (struct ifnet)) != sizeof (struct ifnet))
+			return (NULL);
+
+		entp = if_snapent(snap, snap->nents, ifnet.if_xname,
+		    strlen(ifnet.if_xname));
+		if (entp == NULL)
+			continue;
+
+		entp->ifindex = ifnet.if_index;
+		entp->flags = ifnet.if_flags;
+		ifnet_stats(&ifnet, &entp->stats);
+		snap->nents++;
+	}
+
+	return (snap);
+}
+
 /*
  * Clean up the interface state structure pointed to by `statep'.
  */
-void
-if_statfini(ifstatstate_t *statep)
+static void
+knet_fini(ifstatstate_t *statep)
 {
 	(void) kvm_close(statep->kd);
+	if_snapfree(&statep->snap);
 	free(statep);
 }
+
+/*
+ * Copy the counters we keep out of the ifnet structure pointed to by
+ * `ifp' into `ifstatsp'.  The ifnet doesn't track FIFO errors, and
+ * transmit drops are counted against the send queue.
+ */
+static void
+ifnet_stats(const struct ifnet *ifp, ifstats_t *ifstatsp)
+{
+	ifstatsp->rxbytes = ifp->if_ibytes;
+	ifstatsp->txbytes = ifp->if_obytes;
+	ifstatsp->rxpackets = ifp->if_ipackets;
+	ifstatsp->txpackets = ifp->if_opackets;
+	ifstatsp->rxerrors = ifp->if_ierrors;
+	ifstatsp->txerrors = ifp->if_oerrors;
+	ifstatsp->rxdrops = ifp->if_iqdrops;
+	ifstatsp->txdrops = ifp->if_snd.ifq_drops;
+	ifstatsp->rxfifo = 0;
+	ifstatsp->txfifo = 0;
+	ifstatsp->multicast = ifp->if_imcasts;
+}
@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Linux rtnetlink-based interface statistics gathering routines.  Unlike
+ * the /proc/net/dev flavor, a single binary reply carries both the
+ * interface flags and its (64-bit) counters, so there's no text to parse
+ * and no need for a separate SIOCGIFFLAGS.
+ */
+
+#pragma ident "@(#)ifstat_netlink.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ifstat.h"
+#include "utils.h"
+
+#define	WN_NL_MINBUF	32768		/* initial size of the reply buffer */
+
+#if	HAVE_DECL_IFLA_STATS64
+/*
+ * The shortest IFLA_STATS64 payload that has every counter we keep.
+ * Kernels append to the structure over time, so the payload may be
+ * longer or (with newer headers than kernel) shorter than our idea of it.
+ */
+#define	WN_NL_STATS64MIN	\
+	(offsetof(struct rtnl_link_stats64, tx_fifo_errors) + sizeof (__u64))
+#endif
+
+/*
+ * Copy the counters we keep out of the rtnl_link_stats or
+ * rtnl_link_stats64 structure `st' into the ifstats_t at `ifstatsp'.
+ */
+#define	NL_COPYSTATS(ifstatsp, st) {				\
+	(ifstatsp)->rxbytes = (st).rx_bytes;			\
+	(ifstatsp)->txbytes = (st).tx_bytes;			\
+	(ifstatsp)->rxpackets = (st).rx_packets;		\
+	(ifstatsp)->txpackets = (st).tx_packets;		\
+	(ifstatsp)->rxerrors = (st).rx_errors;			\
+	(ifstatsp)->txerrors = (st).tx_errors;			\
+	(ifstatsp)->rxdrops = (st).rx_dropped;			\
+	(ifstatsp)->txdrops = (st).tx_dropped;			\
+	(ifstatsp)->rxfifo = (st).rx_fifo_errors;		\
+	(ifstatsp)->txfifo = (st).tx_fifo_errors;		\
+	(ifstatsp)->multicast = (st).multicast;			\
+}
+
+struct ifstatstate {
+	int		fd;		/* rtnetlink socket */
+	unsigned int	seq;		/* sequence number of last request */
+	int		flags;		/* flags from last if_stats(), or -1 */
+	unsigned int	ifindex;	/* index from last if_stats(), or 0 */
+	char		*buf;		/* reply buffer */
+	size_t		bufsize;	/* allocated size of `buf' */
+	ifstatsnap_t	snap;		/* last if_statsall() snapshot */
+};
+
+typedef struct {
+	struct nlmsghdr		nh;
+	struct ifinfomsg	ifi;
+	char			attrbuf[RTA_SPACE(IFNAMSIZ)];
+} nlreq_t;
+
+static ifstatstate_t *nl_init(void);
+static int	nl_stats(const char *, ifstatstate_t *, ifstats_t *);
+static const ifstatsnap_t *nl_statsall(ifstatstate_t *);
+static int	nl_flags(ifstatstate_t *);
+static unsigned int nl_ifindex(ifstatstate_t *);
+static void	nl_fini(ifstatstate_t *);
+static int	nl_request(ifstatstate_t *, const char *);
+static int	nl_recv(ifstatstate_t *, ssize_t *);
+static void	nl_drain(ifstatstate_t *);
+static int	nl_parselink(struct nlmsghdr *, const char **, ifstats_t *);
+
+const ifstatops_t ifstat_netlink_ops = {
+	"netlink", nl_init, nl_stats, nl_statsall, nl_flags, nl_fini,
+	NULL, nl_ifindex
+};
+
+/*
+ * Do one-time setup stuff for accessing the interface statistics and store
+ * the gathered information in an interface statistics state structure.
+ * Return the state structure.
+ */
+static ifstatstate_t *
+nl_init(void)
+{
+	ifstatstate_t		*statep;
+	struct sockaddr_nl	snl;
+
+	statep = calloc(1, sizeof (ifstatstate_t));
+	if (statep == NULL) {
+		warn("cannot allocate interface statistics state");
+		return (NULL);
+	}
+
+	statep->bufsize = WN_NL_MINBUF;
+	statep->buf = malloc(statep->bufsize);
+	if (statep->buf == NULL) {
+		warn("cannot allocate interface statistics buffer");
+		free(statep);
+		return (NULL);
+	}
+
+	statep->fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (statep->fd == -1)
+		goto fail;
+
+	(void) memset(&snl, 0, sizeof (snl));
+	snl.nl_family = AF_NETLINK;
+	if (bind(statep->fd, (struct sockaddr *)&snl, sizeof (snl)) == -1) {
+		(void) close(statep->fd);
+		goto fail;
+	}
+
+	statep->flags = -1;
+	return (statep);
+fail:
+	warn("cannot open rtnetlink socket; no stats will be available\n");
+	free(statep->buf);
+	free(statep);
+	return (NULL);
+}
+
+/*
+ * Optionally using state stored in `statep', retrieve stats on interface
+ * `ifname', and store the statistics in `ifstatsp'.
+ */
+static int
+nl_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
+{
+	struct nlmsghdr	*nhp;
+	ssize_t		len;
+	const char	*name;
+
+	statep->flags = -1;
+	statep->ifindex = 0;
+	if (!nl_request(statep, ifname))
+		return (0);
+
+	/*
+	 * Skip past anything left over from an abandoned request until we
+	 * find the reply to ours, which is either the link or an error.
+	 */
+	for (;;) {
+		switch (nl_recv(statep, &len)) {
+		case -1:
+			return (0);
+		case 0:
+			if (!nl_request(statep, ifname))
+				return (0);
+			continue;
+		}
+
+		nhp = (struct nlmsghdr *)statep->buf;
+		for (; NLMSG_OK(nhp, len); nhp = NLMSG_NEXT(nhp, len)) {
+			if (nhp->nlmsg_seq != statep->seq)
+				continue;
+
+			if (nhp->nlmsg_type == NLMSG_ERROR)
+				return (0);
+
+			if (nhp->nlmsg_type != RTM_NEWLINK ||
+			    !nl_parselink(nhp, &name, ifstatsp))
+				return (0);
+
+			statep->flags =
+			    ((struct ifinfomsg *)NLMSG_DATA(nhp))->ifi_flags;
+			statep->ifindex =
+			    ((struct ifinfomsg *)NLMSG_DATA(nhp))->ifi_index;
+			return (1);
+		}
+	}
+}
+
+/*
+ * Return the interface flags that came back with the last successful
+ * call to if_stats(), or -1 if there weren't any.
+ */
+static int
+nl_flags(ifstatstate_t *statep)
+{
+	return (statep->flags);
+}
+
+/*
+ * Return the interface index that came back with the last successful
+ * call to if_stats(), or 0 if there wasn't one.
+ */
+static unsigned int
+nl_ifindex(ifstatstate_t *statep)
+{
+	return (statep->ifindex);
+}
+
+/*
+ * Using state stored in `statep', take a snapshot of the stats on every
+ * interface from a single RTM_GETLINK dump.  Return NULL on failure.
+ */
+static const ifstatsnap_t *
+nl_statsall(ifstatstate_t *statep)
+{
+	ifstatsnap_t	*snap = &statep->snap;
+	ifstatent_t	*entp;
+	struct nlmsghdr	*nhp;
+	ifstats_t	stats;
+	ssize_t		len;
+	const char	*name;
+
+restart:
+	if (!nl_request(statep, NULL))
+		return (NULL);
+
+	snap->nents = 0;
+	for (;;) {
+		switch (nl_recv(statep, &len)) {
+		case -1:
+			nl_drain(statep);
+			return (NULL);
+		case 0:
+			nl_drain(statep);
+			goto restart;	/* buffer was grown; start over */
+		}
+
+		nhp = (struct nlmsghdr *)statep->buf;
+		for (; NLMSG_OK(nhp, len); nhp = NLMSG_NEXT(nhp, len)) {
+			if (nhp->nlmsg_seq != statep->seq)
+				continue;
+
+			if (nhp->nlmsg_type == NLMSG_DONE)
+				return (snap);
+
+			if (nhp->nlmsg_type == NLMSG_ERROR) {
+				nl_drain(statep);
+				return (NULL);
+			}
+
+			if (nhp->nlmsg_type != RTM_NEWLINK ||
+			    !nl_parselink(nhp, &name, &stats) || name == NULL)
+				continue;
+
+			entp = if_snapent(snap, snap->nents, name,
+			    strlen(name));
+			if (entp == NULL)
+				continue;
+
+			entp->ifindex =
+			    ((struct ifinfomsg *)NLMSG_DATA(nhp))->ifi_index;
+			entp->flags =
+			    ((struct ifinfomsg *)NLMSG_DATA(nhp))->ifi_flags;
+			entp->stats = stats;
+			snap->nents++;
+		}
+	}
+}
+
+/*
+ * Clean up the interface state structure pointed to by `statep'.
+ */
+static void
+nl_fini(ifstatstate_t *statep)
+{
+	(void) close(statep->fd);
+	free(statep->buf);
+	if_snapfree(&statep->snap);
+	free(statep);
+}
+
+/*
+ * Send an RTM_GETLINK request for interface `ifname' or, if `ifname' is
+ * NULL, for every interface.  Return 1 on success, 0 on failure.
+ */
+static int
+nl_request(ifstatstate_t *statep, const char *ifname)
+{
+	nlreq_t			req;
+	struct rtattr		*rta;
+	struct sockaddr_nl	snl;
+	size_t			namelen;
+
+	(void) memset(&req, 0, sizeof (req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof (struct ifinfomsg));
+	req.nh.nlmsg_type = RTM_GETLINK;
+	req.nh.nlmsg_flags = NLM_F_REQUEST;
+	req.nh.nlmsg_seq = ++statep->seq;
+	req.ifi.ifi_family = AF_UNSPEC;
+
+	if (ifname == NULL) {
+		req.nh.nlmsg_flags |= NLM_F_DUMP;
+	} else {
+		namelen = strlen(ifname) + 1;
+		if (namelen > IFNAMSIZ)
+			return (0);
+
+		rta = (struct rtattr *)((char *)&req +
+		    NLMSG_ALIGN(req.nh.nlmsg_len));
+		rta->rta_type = IFLA_IFNAME;
+		rta->rta_len = RTA_LENGTH(namelen);
+		(void) memcpy(RTA_DATA(rta), ifname, namelen);
+		req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) +
+		    RTA_ALIGN(rta->rta_len);
+	}
+
+	(void) memset(&snl, 0, sizeof (snl));
+	snl.nl_family = AF_NETLINK;
+
+	while (sendto(statep->fd, &req, req.nh.nlmsg_len, 0,
+	    (struct sockaddr *)&snl, sizeof (snl)) == -1) {
+		if (errno != EINTR)
+			return (0);
+	}
+
+	return (1);
+}
+
+/*
+ * Receive the next batch of replies into the buffer associated with
+ * `statep' and store its length in `lenp'.  Return 1 on success and -1 on
+ * failure.  If the reply didn't fit, grow the buffer and return 0 so that
+ * the caller can repeat its request.
+ */
+static int
+nl_recv(ifstatstate_t *statep, ssize_t *lenp)
+{
+	ssize_t	len;
+	char	*buf;
+
+	do {
+		len = recv(statep->fd, statep->buf, statep->bufsize, MSG_TRUNC);
+	} while (len == -1 && errno == EINTR);
+
+	if (len <= 0)
+		return (-1);
+
+	if ((size_t)len > statep->bufsize) {
+		buf = realloc(statep->buf, len);
+		if (buf == NULL) {
+			warn("cannot grow interface statistics buffer");
+			return (-1);
+		}
+		statep->buf = buf;
+		statep->bufsize = len;
+		return (0);
+	}
+
+	*lenp = len;
+	return (1);
+}
+
+/*
+ * Throw away whatever is left of an abandoned dump.  The kernel only
+ * produces the next part of a dump as the previous one is read, so once
+ * the socket runs dry, the dump is over.
+ */
+static void
+nl_drain(ifstatstate_t *statep)
+{
+	ssize_t	len;
+
+	do {
+		len = recv(statep->fd, statep->buf, statep->bufsize,
+		    MSG_DONTWAIT);
+	} while (len > 0 || (len == -1 && errno == EINTR));
+}
+
+/*
+ * Pull the interface name and the counters out of the RTM_NEWLINK message
+ * pointed to by `nhp', storing them in `namep' and `ifstatsp'.  Prefer the
+ * 64-bit counters, but fall back to the 32-bit ones on older kernels.
+ * Return 1 if the counters were found, 0 otherwise.
+ */
+static int
+nl_parselink(struct nlmsghdr *nhp, const char **namep, ifstats_t *ifstatsp)
+{
+	struct ifinfomsg	*ifip = NLMSG_DATA(nhp);
+	struct rtattr		*rta = IFLA_RTA(ifip);
+	int			len = IFLA_PAYLOAD(nhp);
+	int			found = 0;
+	struct rtnl_link_stats	*st32;
+#if	HAVE_DECL_IFLA_STATS64
+	struct rtnl_link_stats64 st64;
+	size_t			st64len;
+#endif
+
+	*namep = NULL;
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case IFLA_IFNAME:
+			*namep = RTA_DATA(rta);
+			break;
+#if	HAVE_DECL_IFLA_STATS64
+		case IFLA_STATS64:
+			st64len = RTA_PAYLOAD(rta);
+			if (st64len < WN_NL_STATS64MIN)
+				break;
+			if (st64len > sizeof (st64))
+				st64len = sizeof (st64);
+			/*
+			 * The attribute is only 4-byte aligned, so copy it
+			 * out before touching the 64-bit fields.
+			 */
+			(void) memset(&st64, 0, sizeof (st64));
+			(void) memcpy(&st64, RTA_DATA(rta), st64len);
+			NL_COPYSTATS(ifstatsp, st64);
+			found = 64;
+			break;
+#endif
+		case IFLA_STATS:
+			if (found == 64 || RTA_PAYLOAD(rta) < sizeof (*st32))
+				break;
+			st32 = RTA_DATA(rta);
+			NL_COPYSTATS(ifstatsp, *st32);
+			found = 32;
+			break;
+		}
+	}
+
+	return (found != 0);
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Interface statistics replay routines.  Rather than asking the kernel,
+ * these serve up the samples in a trace recorded with `--record', one
+ * sample per call, under a virtual clock that follows the timestamps in
+ * the trace.  The trace is named by the WMNETLOAD_REPLAY environment
+ * variable; see ifrec.h for its format.
+ */
+
+#pragma ident "@(#)ifstat_replay.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ifstat.h"
+#include "ifrec.h"
+#include "utils.h"
+
+#define	WN_REPLAY_ENV	"WMNETLOAD_REPLAY"
+
+struct ifstatstate {
+	const unsigned char *base;	/* mapped trace */
+	size_t		size;		/* size of the mapped trace */
+	const unsigned char *cp;	/* next record in the trace */
+	struct timeval	now;		/* time of the current record */
+	int		done;		/* no more records */
+	int		flags;		/* flags from last if_stats(), or -1 */
+	unsigned int	ifindex;	/* index from last if_stats(), or 0 */
+	ifstatsnap_t	snap;		/* current record */
+};
+
+static ifstatstate_t *rp_init(void);
+static int	rp_stats(const char *, ifstatstate_t *, ifstats_t *);
+static const ifstatsnap_t *rp_statsall(ifstatstate_t *);
+static int	rp_flags(ifstatstate_t *);
+static void	rp_fini(ifstatstate_t *);
+static int	rp_clock(ifstatstate_t *, struct timeval *);
+static unsigned int rp_ifindex(ifstatstate_t *);
+static int	rp_next(ifstatstate_t *);
+
+const ifstatops_t ifstat_replay_ops = {
+	"replay", rp_init, rp_stats, rp_statsall, rp_flags, rp_fini,
+	rp_clock, rp_ifindex
+};
+
+/*
+ * Map in the trace named by WN_REPLAY_ENV, and return a state structure
+ * for replaying it, or NULL on failure.
+ */
+static ifstatstate_t *
+rp_init(void)
+{
+	ifstatstate_t	*statep;
+	const char	*path;
+	struct stat	st;
+	void		*base;
+	int		fd;
+
+	path = getenv(WN_REPLAY_ENV);
+	if (path == NULL) {
+		warn("no trace to replay; set %s\n", WN_REPLAY_ENV);
+		return (NULL);
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		warn("cannot open trace %s", path);
+		return (NULL);
+	}
+
+	if (fstat(fd, &st) == -1 || st.st_size < WN_IFREC_HDRLEN) {
+		warn("cannot replay trace %s: too short\n", path);
+		(void) close(fd);
+		return (NULL);
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void) close(fd);
+	if (base == MAP_FAILED) {
+		warn("cannot map trace %s", path);
+		return (NULL);
+	}
+
+	if (memcmp(base, WN_IFREC_MAGIC, WN_IFREC_MAGICLEN) != 0 ||
+	    ((unsigned char *)base)[WN_IFREC_MAGICLEN] != WN_IFREC_VERSION) {
+		warn("cannot replay %s: not a version %d trace\n", path,
+		    WN_IFREC_VERSION);
+		(void) munmap(base, st.st_size);
+		return (NULL);
+	}
+
+	statep = calloc(1, sizeof (ifstatstate_t));
+	if (statep == NULL) {
+		warn("cannot allocate interface statistics state");
+		(void) munmap(base, st.st_size);
+		return (NULL);
+	}
+
+	statep->base = base;
+	statep->size = st.st_size;
+	statep->cp = statep->base + WN_IFREC_HDRLEN;
+	statep->flags = -1;
+	return (statep);
+}
+
+/*
+ * Move on to the next recorded sample, and store the stats that interface
+ * `ifname' had in it in `ifstatsp'.
+ */
+static int
+rp_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
+{
+	ifstatent_t	*entp;
+	unsigned int	i;
+
+	statep->flags = -1;
+	statep->ifindex = 0;
+	if (!rp_next(statep))
+		return (0);
+
+	for (i = 0; i < statep->snap.nents; i++) {
+		entp = &statep->snap.ents[i];
+		if (strcmp(entp->name, ifname) == 0) {
+			*ifstatsp = entp->stats;
+			statep->flags = entp->flags;
+			statep->ifindex = entp->ifindex;
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Move on to the next recorded sample, and return it.  Return NULL once
+ * there are no more.
+ */
+static const ifstatsnap_t *
+rp_statsall(ifstatstate_t *statep)
+{
+	return (rp_next(statep) ? &statep->snap : NULL);
+}
+
+/*
+ * Return the recorded flags of the interface returned by the last
+ * successful call to if_stats(), or -1 if there weren't any.
+ */
+static int
+rp_flags(ifstatstate_t *statep)
+{
+	return (statep->flags);
+}
+
+/*
+ * Clean up the interface state structure pointed to by `statep'.
+ */
+static void
+rp_fini(ifstatstate_t *statep)
+{
+	(void) munmap((void *)statep->base, statep->size);
+	if_snapfree(&statep->snap);
+	free(statep);
+}
+
+/*
+ * Store the recorded time of the current sample in `tvp'.  Return 1, or
+ * -1 if the trace has run out.
+ */
+static int
+rp_clock(ifstatstate_t *statep, struct timeval *tvp)
+{
+	*tvp = statep->now;
+	return (statep->done ? -1 : 1);
+}
+
+/*
+ * Return the recorded index of the interface returned by the last
+ * successful call to if_stats(), or 0 if there wasn't one.
+ */
+static unsigned int
+rp_ifindex(ifstatstate_t *statep)
+{
+	return (statep->ifindex);
+}
+
+/*
+ * Decode the next record in the trace into the snapshot associated with
+ * `statep', and advance the virtual clock to its timestamp.  Return 1 on
+ * success, or 0 at the end of the trace (or at a garbled record, which
+ * we treat the same way).
+ */
+static int
+rp_next(ifstatstate_t *statep)
+{
+	const unsigned char	*cp = statep->cp;
+	const unsigned char	*end = statep->base + statep->size;
+	ifstatsnap_t		*snap = &statep->snap;
+	ifstatent_t		*entp;
+	unsigned long long	usec, nents, namelen, val;
+	unsigned long long	*ctrs;
+	unsigned int		i, j;
+
+	if (statep->done)
+		return (0);
+
+	if (cp == end)
+		goto done;
+
+	if ((cp = ifrec_getvarint(cp, end, &usec)) == NULL ||
+	    (cp = ifrec_getvarint(cp, end, &nents)) == NULL ||
+	    nents > (unsigned long long)(end - cp) ||
+	    !if_snapgrow(snap, nents))
+		goto garbled;
+
+	for (i = 0; i < nents; i++) {
+		entp = &snap->ents[i];
+
+		if ((cp = ifrec_getvarint(cp, end, &namelen)) == NULL)
+			goto garbled;
+
+		if (namelen != 0) {
+			if (namelen >= IFNAMSIZ ||
+			    namelen > (unsigned long long)(end - cp))
+				goto garbled;
+			(void) memcpy(entp->name, cp, namelen);
+			entp->name[namelen] = '\0';
+			(void) memset(&entp->stats, 0, sizeof (ifstats_t));
+			cp += namelen;
+		} else if (i >= snap->nents) {
+			goto garbled;
+		}
+
+		if ((cp = ifrec_getvarint(cp, end, &val)) == NULL)
+			goto garbled;
+		entp->ifindex = val;
+
+		if ((cp = ifrec_getvarint(cp, end, &val)) == NULL)
+			goto garbled;
+		entp->flags = (int)val - 1;
+
+		ctrs = (unsigned long long *)&entp->stats;
+		for (j = 0; j < WN_IFSTATS_NCTRS; j++) {
+			if ((cp = ifrec_getvarint(cp, end, &val)) == NULL)
+				goto garbled;
+			ctrs[j] += (val >> 1) ^ -(val & 1);
+		}
+	}
+
+	snap->nents = nents;
+	statep->cp = cp;
+	statep->now.tv_sec += usec / 1000000;
+	statep->now.tv_usec += usec % 1000000;
+	if (statep->now.tv_usec >= 1000000) {
+		statep->now.tv_sec++;
+		statep->now.tv_usec -= 1000000;
+	}
+	return (1);
+
+garbled:
+	warn("replayed trace is garbled at offset %lu; stopping\n",
+	    (unsigned long)(statep->cp - statep->base));
+done:
+	statep->done = 1;
+	return (0);
+}
@@ -33,6 +33,8 @@
 #include <net/if.h>
 #include <ctype.h>
 #include <kstat.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -41,6 +43,46 @@
 
 struct ifstatstate {
 	kstat_ctl_t		*kcp;		/* kstat instance pointer */
+	unsigned int		ifindex;	/* index from last if_stats() */
+	ifstatent_t		last;		/* interface of last if_stats() */
+	ifstatsnap_t		snap;		/* last if_statsall() snap */
+};
+
+/*
+ * The kstats we keep, and where each one goes in an ifstats_t.  Only the
+ * byte counts are required; not every driver exports the rest.
+ */
+static const struct {
+	const char	*name;
+	size_t		off;
+} ks_ctrs[] = {
+	{ "rbytes",	offsetof(ifstats_t, rxbytes) },
+	{ "obytes",	offsetof(ifstats_t, txbytes) },
+	{ "ipackets",	offsetof(ifstats_t, rxpackets) },
+	{ "opackets",	offsetof(ifstats_t, txpackets) },
+	{ "ierrors",	offsetof(ifstats_t, rxerrors) },
+	{ "oerrors",	offsetof(ifstats_t, txerrors) },
+	{ "norcvbuf",	offsetof(ifstats_t, rxdrops) },
+	{ "noxmtbuf",	offsetof(ifstats_t, txdrops) },
+	{ "overflows",	offsetof(ifstats_t, rxfifo) },
+	{ "underflows",	offsetof(ifstats_t, txfifo) },
+	{ "multircv",	offsetof(ifstats_t, multicast) }
+};
+
+#define	WN_KS_NCTRS	(sizeof (ks_ctrs) / sizeof (ks_ctrs[0]))
+#define	WN_KS_NREQ	2	/* number of required kstats in ks_ctrs[] */
+
+static ifstatstate_t *kst_init(void);
+static int	kst_stats(const char *, ifstatstate_t *, ifstats_t *);
+static const ifstatsnap_t *kst_statsall(ifstatstate_t *);
+static int	kst_flags(ifstatstate_t *);
+static unsigned int kst_ifindex(ifstatstate_t *);
+static void	kst_fini(ifstatstate_t *);
+static int	ks_stats(kstat_t *, ifstats_t *);
+
+const ifstatops_t ifstat_solaris_ops = {
+	"solaris", kst_init, kst_stats, kst_statsall, kst_flags, kst_fini,
+	NULL, kst_ifindex
 };
 
 /*
@@ -48,8 +90,8 @@ struct ifstatstate {
  * the gathered information in an interface statistics state structure.
  * Return the state structure.
  */
-ifstatstate_t *
-if_statinit(void)
+static ifstatstate_t *
+kst_init(void)
 {
 	ifstatstate_t	*statep;
 
@@ -73,14 +115,15 @@ if_statinit(void)
  * Optionally using state stored in `statep', retrieve stats on interface
  * `ifname', and store the statistics in `ifstatsp'.
  */
-int
-if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
+static int
+kst_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 {
 	kstat_t		*ksp;
-	kstat_named_t	*krp, *ktp;
 	const char	*ifnamep;
 	char		ifbuf[IFNAMSIZ];
+	ifstatent_t	*lastp;
 
+	statep->ifindex = 0;
 	ifnamep = ifname + strlen(ifname) - 1;
 	while (&ifnamep[-1] >= ifname && isdigit(ifnamep[-1]))
 		ifnamep--;
@@ -95,23 +138,132 @@ if_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
 	if (kstat_read(statep->kcp, ksp, NULL) == -1)
 		return (0);
 
-	krp = kstat_data_lookup(ksp, "rbytes");
-	ktp = kstat_data_lookup(ksp, "obytes");
-	if (krp == NULL || ktp == NULL)
+	if (!ks_stats(ksp, ifstatsp))
 		return (0);
 
-	ifstatsp->rxbytes = krp->value.ul;
-	ifstatsp->txbytes = ktp->value.ul;
-
+	/*
+	 * The kstats don't carry the index, so keep the one we looked up
+	 * last until the interface changes or its counters are reset.
+	 */
+	lastp = &statep->last;
+	if (if_snapstale(lastp, ifname, ifstatsp)) {
+		(void) strncpy(lastp->name, ifname, IFNAMSIZ - 1);
+		lastp->ifindex = if_nametoindex(ifname);
+	}
+	lastp->stats = *ifstatsp;
+	statep->ifindex = lastp->ifindex;
 	return (1);
 }
 
+/*
+ * Return the interface flags that came back with the last successful
+ * call to if_stats(), or -1 if there weren't any.  There never are,
+ * since the kstats don't carry them.
+ */
+/* ARGSUSED */
+static int
+kst_flags(ifstatstate_t *statep)
+{
+	return (-1);
+}
+
+/*
+ * Return the interface index that came back with the last successful
+ * call to if_stats(), or 0 if there wasn't one.
+ */
+static unsigned int
+kst_ifindex(ifstatstate_t *statep)
+{
+	return (statep->ifindex);
+}
+
+/*
+ * Using state stored in `statep', take a snapshot of the stats on every
+ * interface by walking the kstat chain for per-interface "net" kstats
+ * (the ones named after their module and instance, like "hme0").  Return
+ * NULL on failure.
+ */
+static const ifstatsnap_t *
+kst_statsall(ifstatstate_t *statep)
+{
+	kstat_t		*ksp;
+	ifstatsnap_t	*snap = &statep->snap;
+	ifstatent_t	*entp;
+	ifstats_t	stats;
+	char		ifbuf[IFNAMSIZ];
+
+	if (kstat_chain_update(statep->kcp) == -1)
+		return (NULL);
+
+	snap->nents = 0;
+	for (ksp = statep->kcp->kc_chain; ksp != NULL; ksp = ksp->ks_next) {
+		if (ksp->ks_type != KSTAT_TYPE_NAMED ||
+		    strcmp(ksp->ks_class, "net") != 0)
+			continue;
+
+		(void) snprintf(ifbuf, sizeof (ifbuf), "%s%d", ksp->ks_module,
+		    ksp->ks_instance);
+		if (strcmp(ifbuf, ksp->ks_name) != 0)
+			continue;
+
+		if (kstat_read(statep->kcp, ksp, NULL) == -1)
+			continue;
+
+		entp = if_snapent(snap, snap->nents, ifbuf, strlen(ifbuf));
+		if (entp == NULL)
+			continue;
+
+		if (ks_stats(ksp, &stats)) {
+			if (if_snapstale(entp, entp->name, &stats))
+				entp->ifindex = if_nametoindex(entp->name);
+			entp->stats = stats;
+			entp->flags = -1;
+			snap->nents++;
+		}
+	}
+
+	return (snap);
+}
+
 /*
  * Clean up the interface state structure pointed to by `statep'.
  */
-void
-if_statfini(ifstatstate_t *statep)
+static void
+kst_fini(ifstatstate_t *statep)
 {
 	(void) kstat_close(statep->kcp);
+	if_snapfree(&statep->snap);
 	free(statep);
 }
+
+/*
+ * Copy the counters we keep out of the freshly-read kstat pointed to by
+ * `ksp' into `ifstatsp'.  Return 1 on success, 0 if the byte counts are
+ * missing.
+ */
+static int
+ks_stats(kstat_t *ksp, ifstats_t *ifstatsp)
+{
+	kstat_named_t		*knp;
+	unsigned long long	val;
+	unsigned int		i;
+
+	for (i = 0; i < WN_KS_NCTRS; i++) {
+		knp = kstat_data_lookup(ksp, (char *)ks_ctrs[i].name);
+		if (knp == NULL) {
+			if (i < WN_KS_NREQ)
+				return (0);
+			val = 0;
+		} else if (knp->data_type == KSTAT_DATA_UINT64) {
+			val = knp->value.ui64;
+		} else if (knp->data_type == KSTAT_DATA_UINT32) {
+			val = knp->value.ui32;
+		} else {
+			val = knp->value.ul;
+		}
+		*(unsigned long long *)((char *)ifstatsp +
+		    ks_ctrs[i].off) = val;
+	}
+
+	return (1);
+}
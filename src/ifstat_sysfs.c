@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Linux sysfs-based interface statistics gathering routines.  Each
+ * counter lives in its own tiny file, so rather than walking the whole
+ * device table, we open the files for a monitored interface once and then
+ * just pread() them on every sample.  Snapshots of every interface can't
+ * afford to hold a dozen descriptors per interface, so they open, read
+ * and close the files as they go.
+ */
+
+#pragma ident "@(#)ifstat_sysfs.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ifstat.h"
+#include "utils.h"
+
+/*
+ * The sysfs root can be overridden through the environment so that this
+ * can be run against a fixture tree rather than the live system.
+ */
+#define	WN_SYSFS_ROOT	"/sys/class/net"
+#define	WN_SYSFS_ENV	"WMNETLOAD_SYSFS"
+#define	WN_SYSFS_MAXCACHE 16		/* most interfaces kept open */
+
+/*
+ * The per-interface files we keep open.  The counters come first, in the
+ * same order as the fields of ifstats_t; the flags file comes last.
+ * Since sysfs has a file per counter, each extra counter costs an extra
+ * pread() per sample.
+ */
+enum { SF_RXBYTES, SF_TXBYTES, SF_FLAGS = WN_IFSTATS_NCTRS, SF_NFILES };
+
+static const char *sf_files[SF_NFILES] = {
+	"statistics/rx_bytes",		"statistics/tx_bytes",
+	"statistics/rx_packets",	"statistics/tx_packets",
+	"statistics/rx_errors",		"statistics/tx_errors",
+	"statistics/rx_dropped",	"statistics/tx_dropped",
+	"statistics/rx_fifo_errors",	"statistics/tx_fifo_errors",
+	"statistics/multicast",		"flags"
+};
+
+/*
+ * The interfaces sampled through if_stats(), kept sorted by name.  Only
+ * the `maxcache' most recently used stay open.
+ */
+typedef struct {
+	char		name[IFNAMSIZ];	/* interface name */
+	int		fds[SF_NFILES];	/* descriptors, indexed by SF_* */
+	unsigned int	ifindex;	/* index when the files were opened */
+	unsigned long	lastused;	/* `statep->nlookups' when last used */
+} sfcache_t;
+
+struct ifstatstate {
+	const char	*root;		/* sysfs network class directory */
+	sfcache_t	cache[WN_SYSFS_MAXCACHE]; /* cached descriptors */
+	unsigned int	ncache;		/* number of entries in `cache' */
+	unsigned int	maxcache;	/* most entries to keep in `cache' */
+	unsigned long	nlookups;	/* number of cache lookups */
+	int		flags;		/* flags from last if_stats(), or -1 */
+	unsigned int	ifindex;	/* index from last if_stats(), or 0 */
+	ifstatsnap_t	snap;		/* last if_statsall() snapshot */
+};
+
+static ifstatstate_t *sf_init(void);
+static int	sf_stats(const char *, ifstatstate_t *, ifstats_t *);
+static const ifstatsnap_t *sf_statsall(ifstatstate_t *);
+static int	sf_flags(ifstatstate_t *);
+static unsigned int sf_ifindex(ifstatstate_t *);
+static void	sf_fini(ifstatstate_t *);
+static unsigned int sf_slot(const ifstatstate_t *, const char *);
+static sfcache_t *sf_find(ifstatstate_t *, const char *);
+static unsigned int sf_lru(const ifstatstate_t *);
+static sfcache_t *sf_lookup(ifstatstate_t *, const char *);
+static int	sf_open(ifstatstate_t *, const char *, sfcache_t *);
+static int	sf_sample(const sfcache_t *, int, ifstats_t *, int *);
+static int	sf_readat(int, const char *, int, unsigned long long *);
+static int	sf_readull(int, int, unsigned long long *);
+static void	sf_close(sfcache_t *);
+static void	sf_evict(ifstatstate_t *, unsigned int);
+
+const ifstatops_t ifstat_sysfs_ops = {
+	"sysfs", sf_init, sf_stats, sf_statsall, sf_flags, sf_fini,
+	NULL, sf_ifindex
+};
+
+/*
+ * Do one-time setup stuff for accessing the interface statistics and store
+ * the gathered information in an interface statistics state structure.
+ * Return the state structure.
+ */
+static ifstatstate_t *
+sf_init(void)
+{
+	ifstatstate_t	*statep;
+	struct rlimit	rl;
+
+	statep = calloc(1, sizeof (ifstatstate_t));
+	if (statep == NULL) {
+		warn("cannot allocate interface statistics state");
+		return (NULL);
+	}
+
+	statep->root = getenv(WN_SYSFS_ENV);
+	if (statep->root == NULL)
+		statep->root = WN_SYSFS_ROOT;
+
+	if (access(statep->root, R_OK | X_OK) == -1) {
+		warn("cannot access %s; no stats will be available\n",
+		    statep->root);
+		free(statep);
+		return (NULL);
+	}
+
+	/*
+	 * Leave at least three quarters of our descriptors to the rest of
+	 * the program (if_statsall() included).
+	 */
+	statep->maxcache = WN_SYSFS_MAXCACHE;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+	    rl.rlim_cur != RLIM_INFINITY &&
+	    rl.rlim_cur / 4 / SF_NFILES < statep->maxcache) {
+		statep->maxcache = rl.rlim_cur / 4 / SF_NFILES;
+		if (statep->maxcache == 0)
+			statep->maxcache = 1;
+	}
+
+	statep->flags = -1;
+	return (statep);
+}
+
+/*
+ * Optionally using state stored in `statep', retrieve stats on interface
+ * `ifname', and store the statistics in `ifstatsp'.
+ */
+static int
+sf_stats(const char *ifname, ifstatstate_t *statep, ifstats_t *ifstatsp)
+{
+	sfcache_t	*sfp;
+	int		tries;
+
+	statep->flags = -1;
+	statep->ifindex = 0;
+
+	/*
+	 * If the interface went away since we opened its files, the reads
+	 * fail; drop the stale descriptors and try once more in case it
+	 * has been re-created under the same name.
+	 */
+	for (tries = 0; tries < 2; tries++) {
+		sfp = sf_lookup(statep, ifname);
+		if (sfp == NULL)
+			return (0);
+
+		if (sf_sample(sfp, -1, ifstatsp, &statep->flags)) {
+			statep->ifindex = sfp->ifindex;
+			return (1);
+		}
+
+		sf_evict(statep, sfp - statep->cache);
+	}
+
+	return (0);
+}
+
+/*
+ * Return the interface flags that came back with the last successful
+ * call to if_stats(), or -1 if there weren't any.
+ */
+static int
+sf_flags(ifstatstate_t *statep)
+{
+	return (statep->flags);
+}
+
+/*
+ * Return the interface index that came back with the last successful
+ * call to if_stats(), or 0 if there wasn't one.
+ */
+static unsigned int
+sf_ifindex(ifstatstate_t *statep)
+{
+	return (statep->ifindex);
+}
+
+/*
+ * Using state stored in `statep', take a snapshot of the stats on every
+ * interface.  Unlike the other flavors, this costs a directory walk plus
+ * a dozen opens and reads per interface, since sysfs has no single table;
+ * only interfaces already open for if_stats() are read in place.  Return
+ * NULL on failure.
+ */
+static const ifstatsnap_t *
+sf_statsall(ifstatstate_t *statep)
+{
+	ifstatsnap_t	*snap = &statep->snap;
+	ifstatent_t	*entp;
+	sfcache_t	*sfp;
+	struct dirent	*dep;
+	DIR		*dirp;
+	unsigned long long ifindex;
+	int		dfd, ok;
+
+	dirp = opendir(statep->root);
+	if (dirp == NULL)
+		return (NULL);
+
+	snap->nents = 0;
+	while ((dep = readdir(dirp)) != NULL) {
+		if (dep->d_name[0] == '.')
+			continue;
+
+		entp = if_snapent(snap, snap->nents, dep->d_name,
+		    strlen(dep->d_name));
+		if (entp == NULL)
+			continue;
+
+		sfp = sf_find(statep, dep->d_name);
+		if (sfp != NULL &&
+		    sf_sample(sfp, -1, &entp->stats, &entp->flags)) {
+			entp->ifindex = sfp->ifindex;
+			snap->nents++;
+			continue;
+		}
+
+		while ((dfd = openat(dirfd(dirp), dep->d_name,
+		    O_RDONLY | O_DIRECTORY)) == -1 &&
+		    (errno == EMFILE || errno == ENFILE) && statep->ncache > 0)
+			sf_evict(statep, sf_lru(statep));
+		if (dfd == -1)
+			continue;
+
+		ok = sf_sample(NULL, dfd, &entp->stats, &entp->flags);
+		if (ok) {
+			entp->ifindex = 0;
+			if (sf_readat(dfd, "ifindex", 10, &ifindex))
+				entp->ifindex = ifindex;
+			snap->nents++;
+		}
+		(void) close(dfd);
+	}
+	(void) closedir(dirp);
+
+	return (snap);
+}
+
+/*
+ * Clean up the interface state structure pointed to by `statep'.
+ */
+static void
+sf_fini(ifstatstate_t *statep)
+{
+	unsigned int i;
+
+	for (i = 0; i < statep->ncache; i++)
+		sf_close(&statep->cache[i]);
+
+	if_snapfree(&statep->snap);
+	free(statep);
+}
+
+/*
+ * Return the slot in the cache in `statep' where interface `ifname' is,
+ * or would go if it were there.
+ */
+static unsigned int
+sf_slot(const ifstatstate_t *statep, const char *ifname)
+{
+	unsigned int	lo = 0, hi = statep->ncache, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(statep->cache[mid].name, ifname) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+/*
+ * Return the cache entry for interface `ifname', or NULL if its files
+ * aren't open.
+ */
+static sfcache_t *
+sf_find(ifstatstate_t *statep, const char *ifname)
+{
+	unsigned int i = sf_slot(statep, ifname);
+
+	if (i < statep->ncache && strcmp(statep->cache[i].name, ifname) == 0)
+		return (&statep->cache[i]);
+
+	return (NULL);
+}
+
+/*
+ * Return the slot of the least recently used entry in the (non-empty)
+ * cache in `statep'.
+ */
+static unsigned int
+sf_lru(const ifstatstate_t *statep)
+{
+	unsigned int i, lru = 0;
+
+	for (i = 1; i < statep->ncache; i++) {
+		if (statep->cache[i].lastused < statep->cache[lru].lastused)
+			lru = i;
+	}
+	return (lru);
+}
+
+/*
+ * Find the cache entry for interface `ifname', opening its files if we
+ * haven't already.  If the cache is full, or we're out of descriptors,
+ * close the files of the least recently used entries to make room.
+ * Return NULL if the interface doesn't exist, or its files can't be
+ * opened.
+ */
+static sfcache_t *
+sf_lookup(ifstatstate_t *statep, const char *ifname)
+{
+	sfcache_t	ent;
+	unsigned int	i;
+
+	statep->nlookups++;
+	i = sf_slot(statep, ifname);
+	if (i < statep->ncache && strcmp(statep->cache[i].name, ifname) == 0) {
+		statep->cache[i].lastused = statep->nlookups;
+		return (&statep->cache[i]);
+	}
+
+	if (strlen(ifname) >= IFNAMSIZ)
+		return (NULL);
+
+	if (statep->ncache == statep->maxcache)
+		sf_evict(statep, sf_lru(statep));
+
+	while (!sf_open(statep, ifname, &ent)) {
+		if (errno != EMFILE && errno != ENFILE)
+			return (NULL);
+
+		if (statep->ncache == 0) {
+			warn("cannot open the statistics files for %s",
+			    ifname);
+			return (NULL);
+		}
+		sf_evict(statep, sf_lru(statep));
+	}
+	ent.lastused = statep->nlookups;
+
+	i = sf_slot(statep, ifname);
+	(void) memmove(&statep->cache[i + 1], &statep->cache[i],
+	    (statep->ncache - i) * sizeof (sfcache_t));
+	statep->cache[i] = ent;
+	statep->ncache++;
+	return (&statep->cache[i]);
+}
+
+/*
+ * Open the files for interface `ifname' into the cache entry pointed to
+ * by `sfp'.  Return 1 on success, or 0 with errno set on failure.
+ */
+static int
+sf_open(ifstatstate_t *statep, const char *ifname, sfcache_t *sfp)
+{
+	char		path[PATH_MAX];
+	unsigned long long ifindex;
+	unsigned int	i;
+	int		dfd, err;
+
+	(void) snprintf(path, sizeof (path), "%s/%s", statep->root, ifname);
+	dfd = open(path, O_RDONLY | O_DIRECTORY);
+	if (dfd == -1)
+		return (0);
+
+	(void) strcpy(sfp->name, ifname);
+	for (i = 0; i < SF_NFILES; i++)
+		sfp->fds[i] = openat(dfd, sf_files[i], O_RDONLY);
+
+	/*
+	 * Only the byte counts are required.
+	 */
+	if (sfp->fds[SF_RXBYTES] == -1 || sfp->fds[SF_TXBYTES] == -1) {
+		err = errno;
+		sf_close(sfp);
+		(void) close(dfd);
+		errno = err;
+		return (0);
+	}
+
+	/*
+	 * The index is fixed for the life of the interface, so read it
+	 * just once; a change means the interface has been re-created.
+	 */
+	sfp->ifindex = 0;
+	if (sf_readat(dfd, "ifindex", 10, &ifindex))
+		sfp->ifindex = ifindex;
+	(void) close(dfd);
+	return (1);
+}
+
+/*
+ * Read the counters for the interface cached at `sfp' or, if `sfp' is
+ * NULL, whose sysfs directory is open on `dfd', into `ifstatsp', and its
+ * flags (or -1 if unavailable) into `flagsp'.  Return 1 on success, 0 on
+ * failure.
+ */
+static int
+sf_sample(const sfcache_t *sfp, int dfd, ifstats_t *ifstatsp, int *flagsp)
+{
+	unsigned long long	*ctrs = (unsigned long long *)ifstatsp;
+	unsigned long long	val;
+	unsigned int		i;
+	int			ok;
+
+	*flagsp = -1;
+	for (i = 0; i < SF_NFILES; i++) {
+		if (sfp != NULL) {
+			ok = (sfp->fds[i] != -1 && sf_readull(sfp->fds[i],
+			    i == SF_FLAGS ? 16 : 10, &val));
+		} else {
+			ok = sf_readat(dfd, sf_files[i],
+			    i == SF_FLAGS ? 16 : 10, &val);
+		}
+
+		/*
+		 * Only the byte counts are required.
+		 */
+		if (!ok && (i == SF_RXBYTES || i == SF_TXBYTES))
+			return (0);
+
+		if (i == SF_FLAGS)
+			*flagsp = ok ? (int)val : -1;
+		else
+			ctrs[i] = ok ? val : 0;
+	}
+
+	return (1);
+}
+
+/*
+ * Read the single number in file `file' under the directory open on
+ * `dfd', in base `base', into `valp'.  Return 1 on success, 0 on failure.
+ */
+static int
+sf_readat(int dfd, const char *file, int base, unsigned long long *valp)
+{
+	int	fd, ok;
+
+	fd = openat(dfd, file, O_RDONLY);
+	if (fd == -1)
+		return (0);
+
+	ok = sf_readull(fd, base, valp);
+	(void) close(fd);
+	return (ok);
+}
+
+/*
+ * Read the single number in the sysfs file open on `fd', in base `base',
+ * into `valp'.  Return 1 on success, 0 on failure.
+ */
+static int
+sf_readull(int fd, int base, unsigned long long *valp)
+{
+	char	buf[32];
+	char	*end;
+	ssize_t	len;
+
+	do {
+		len = pread(fd, buf, sizeof (buf) - 1, 0);
+	} while (len == -1 && errno == EINTR);
+
+	if (len <= 0)
+		return (0);
+
+	buf[len] = '\0';
+	*valp = strtoull(buf, &end, base);
+	return (end != buf);
+}
+
+/*
+ * Close the descriptors held by the cache entry pointed to by `sfp'.
+ */
+static void
+sf_close(sfcache_t *sfp)
+{
+	unsigned int i;
+
+	for (i = 0; i < SF_NFILES; i++) {
+		if (sfp->fds[i] != -1)
+			(void) close(sfp->fds[i]);
+	}
+}
+
+/*
+ * Close and remove cache entry `i' from `statep'.
+ */
+static void
+sf_evict(ifstatstate_t *statep, unsigned int i)
+{
+	sf_close(&statep->cache[i]);
+	statep->ncache--;
+	(void) memmove(&statep->cache[i], &statep->cache[i + 1],
+	    (statep->ncache - i) * sizeof (sfcache_t));
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Warm-start state routines.  See ifstate.h for what's saved, and when
+ * it's loaded back.
+ */
+
+#pragma ident "@(#)ifstate.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <float.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ifstate.h"
+#include "utils.h"
+
+#define	WN_IFSTATE_BOOTID	"/proc/sys/kernel/random/boot_id"
+
+static int	ifs_bootid(char *);
+static int	ifs_colvalid(const ifgcol_t *, unsigned int);
+
+/*
+ * Save the state of the interface described by `ifp', which is being
+ * monitored every `interval' milliseconds with samples taken by the
+ * backend named `backend', to `path'.  Return 1 on
+ * success, 0 on failure (with errno set).  Where the system can't tell
+ * one boot from the next, it's still saved, but never loaded back.
+ */
+int
+ifstate_save(const char *path, const ifinfo_t *ifp, unsigned int interval,
+    const char *backend)
+{
+	const ifgraph_t	*graph = ifp->graph;
+	ifstatehdr_t	hdr;
+	char		tmppath[PATH_MAX];
+	FILE		*fp;
+	int		ok;
+
+	(void) memset(&hdr, 0, sizeof (hdr));
+	(void) memcpy(hdr.magic, WN_IFSTATE_MAGIC, WN_IFSTATE_MAGICLEN);
+	hdr.version = WN_IFSTATE_VERSION;
+	(void) ifs_bootid(hdr.bootid);
+	(void) strncpy(hdr.backend, backend, WN_IFSTATE_BACKENDLEN - 1);
+	(void) strncpy(hdr.ifname, ifp->name, IFNAMSIZ - 1);
+	hdr.interval = interval;
+	hdr.ncols = graph->ncols;
+	hdr.height = graph->height;
+	hdr.scale = graph->scale;
+	hdr.last = ifp->last;
+	hdr.stats = ifp->stats;
+	hdr.discards = ifp->discards;
+	hdr.bps2bar = graph->bps2bar;
+	hdr.minbps2bar = graph->minbps2bar;
+	hdr.col = graph->col;
+	hdr.maxcol = graph->maxcol;
+	hdr.next = graph->next;
+
+	(void) snprintf(tmppath, sizeof (tmppath), "%s.tmp", path);
+	fp = fopen(tmppath, "wb");
+	if (fp == NULL)
+		return (0);
+
+	ok = (fwrite(&hdr, sizeof (hdr), 1, fp) == 1 &&
+	    fwrite(graph->cols, sizeof (ifgcol_t), graph->ncols, fp) ==
+	    graph->ncols);
+	if (fclose(fp) != 0)
+		ok = 0;
+
+	if (!ok || rename(tmppath, path) == -1) {
+		(void) remove(tmppath);
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * Load the state saved in `path' into the interface described by `ifp',
+ * which is about to be monitored every `interval' milliseconds by the
+ * backend named `backend', provided it's from this boot and was saved for
+ * the same backend, interface, interval and graph.  A file with a zero
+ * graph scale, or with a column that doesn't fit the graph, is damaged
+ * (the scale is divided by, and the columns drawn as is), so it's refused.
+ * Return 1 if it was loaded, 0 if not.
+ */
+int
+ifstate_load(const char *path, ifinfo_t *ifp, unsigned int interval,
+    const char *backend)
+{
+	ifgraph_t	*graph = ifp->graph;
+	ifstatehdr_t	hdr;
+	ifgcol_t	*cols;
+	char		bootid[WN_IFSTATE_BOOTIDLEN];
+	FILE		*fp;
+	unsigned int	i;
+	int		ok;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return (0);
+
+	cols = malloc(graph->ncols * sizeof (ifgcol_t));
+	ok = (cols != NULL && fread(&hdr, sizeof (hdr), 1, fp) == 1 &&
+	    memcmp(hdr.magic, WN_IFSTATE_MAGIC, WN_IFSTATE_MAGICLEN) == 0 &&
+	    hdr.version == WN_IFSTATE_VERSION && ifs_bootid(bootid) &&
+	    strncmp(hdr.bootid, bootid, WN_IFSTATE_BOOTIDLEN) == 0 &&
+	    strncmp(hdr.backend, backend, WN_IFSTATE_BACKENDLEN) == 0 &&
+	    strncmp(hdr.ifname, ifp->name, IFNAMSIZ) == 0 &&
+	    hdr.interval == interval && hdr.ncols == graph->ncols &&
+	    hdr.height == graph->height && hdr.scale == graph->scale &&
+	    hdr.col < hdr.ncols && hdr.maxcol < hdr.ncols &&
+	    hdr.bps2bar != 0 && hdr.minbps2bar != 0 &&
+	    fread(cols, sizeof (ifgcol_t), graph->ncols, fp) == graph->ncols &&
+	    ifs_colvalid(&hdr.next, hdr.height));
+	(void) fclose(fp);
+
+	for (i = 0; ok && i < graph->ncols; i++)
+		ok = ifs_colvalid(&cols[i], hdr.height);
+
+	if (!ok) {
+		free(cols);
+		return (0);
+	}
+
+	ifp->last = hdr.last;
+	ifp->stats = hdr.stats;
+	ifp->discards = hdr.discards;
+	graph->bps2bar = hdr.bps2bar;
+	graph->minbps2bar = hdr.minbps2bar;
+	graph->col = hdr.col;
+	graph->maxcol = hdr.maxcol;
+	graph->next = hdr.next;
+	(void) memcpy(graph->cols, cols, graph->ncols * sizeof (ifgcol_t));
+	free(cols);
+	return (1);
+}
+
+/*
+ * Store this boot's ID in `bootid' (which must have room for
+ * WN_IFSTATE_BOOTIDLEN bytes).  Return 1 on success, or 0 (leaving it
+ * empty) if the system doesn't have one.
+ */
+static int
+ifs_bootid(char *bootid)
+{
+	FILE	*fp;
+	char	*cp;
+
+	bootid[0] = '\0';
+	fp = fopen(WN_IFSTATE_BOOTID, "r");
+	if (fp == NULL)
+		return (0);
+
+	if (fgets(bootid, WN_IFSTATE_BOOTIDLEN, fp) == NULL)
+		bootid[0] = '\0';
+	(void) fclose(fp);
+
+	if ((cp = strchr(bootid, '\n')) != NULL)
+		*cp = '\0';
+	return (bootid[0] != '\0');
+}
+
+/*
+ * Return 1 if the graph column pointed to by `colp' fits a graph `height'
+ * pixels high: its bars and peaks are no taller than that, and its rates
+ * are all finite and not negative.  Otherwise, return 0.
+ */
+static int
+ifs_colvalid(const ifgcol_t *colp, unsigned int height)
+{
+	const float	rates[] = { colp->rxmean, colp->rxmin, colp->rxmax,
+			    colp->txmean, colp->txmin, colp->txmax };
+	unsigned int	i;
+
+	if (colp->rbar > height || colp->tbar > height ||
+	    colp->rpeak > height || colp->tpeak > height)
+		return (0);
+
+	for (i = 0; i < sizeof (rates) / sizeof (rates[0]); i++) {
+		if (!(rates[i] >= 0 && rates[i] <= FLT_MAX))
+			return (0);
+	}
+	return (1);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Warm-start state.  So that a restarted wmnetload (say, after the window
+ * manager or X server went away) picks up where it left off, the state of
+ * the interface being monitored -- its graph and scale, its last sample
+ * and the 64-bit counters carried on from it -- is saved to a small file
+ * now and then, and on exit.  It's only loaded back if it's from the same
+ * boot (sample timestamps are on the monotonic clock, which starts over
+ * at boot) and for the same backend, interface, interval and graph shape;
+ * since each backend counts in its own way, a sample taken by one means
+ * nothing to another.
+ *
+ * The file is an ifstatehdr_t followed by the graph's columns, stored in
+ * host byte order, and is replaced with rename() so that it's never seen
+ * half-written.
+ */
+
+#ifndef	WN_IFSTATE_H
+#define	WN_IFSTATE_H
+
+#pragma ident "@(#)ifstate.h	1.1	26/10/17 meem"
+
+#include <sys/types.h>
+#include <net/if.h>
+
+#include "ifgraph.h"
+#include "ifinfo.h"
+
+#define	WN_IFSTATE_MAGIC	"WNWS"
+#define	WN_IFSTATE_MAGICLEN	4
+#define	WN_IFSTATE_VERSION	2
+#define	WN_IFSTATE_BOOTIDLEN	40	/* room for a UUID and a NUL */
+#define	WN_IFSTATE_BACKENDLEN	16	/* room for a backend name */
+
+typedef struct {
+	char		magic[WN_IFSTATE_MAGICLEN]; /* WN_IFSTATE_MAGIC */
+	unsigned int	version;	/* WN_IFSTATE_VERSION */
+	char		bootid[WN_IFSTATE_BOOTIDLEN]; /* boot saved during */
+	char		backend[WN_IFSTATE_BACKENDLEN]; /* backend sampled by */
+	char		ifname[IFNAMSIZ]; /* interface saved */
+	unsigned int	interval;	/* update interval, in milliseconds */
+	unsigned int	ncols;		/* graph columns that follow */
+	unsigned int	height;		/* graph height */
+	ifgscale_t	scale;		/* what the graph was scaled to fit */
+	ifsample_t	last;		/* last sample, as taken */
+	ifstats_t	stats;		/* 64-bit counters as of then */
+	ulonglong_t	discards;	/* samples discarded as resets */
+	ulonglong_t	bps2bar;	/* graph scale */
+	ulonglong_t	minbps2bar;
+	unsigned int	col;		/* current graph column */
+	unsigned int	maxcol;		/* column controlling bps2bar */
+	ifgcol_t	next;		/* rates sampled for the next column */
+} ifstatehdr_t;
+
+extern int		ifstate_save(const char *, const ifinfo_t *,
+			    unsigned int, const char *);
+extern int		ifstate_load(const char *, ifinfo_t *, unsigned int,
+			    const char *);
+
+#endif /* WN_IFSTATE_H */
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * The sampling schedule.  Deadlines are absolute times on the monotonic
+ * clock; where there's a timerfd, it's armed with them directly, so the
+ * kernel wakes us at the right time rather than us working out (and
+ * rounding) how long to sleep.
+ */
+
+#pragma ident "@(#)sched.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef	HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
+#include "sched.h"
+#include "utils.h"
+
+#define	WN_NSPERMS	1000000LL	/* nanoseconds per millisecond */
+#define	WN_NSPERSEC	1000000000LL	/* nanoseconds per second */
+#define	WN_SCHED_MAXMS	(86400U * 1000)	/* longest interval (a day) */
+
+struct sched {
+	long long	interval;	/* period length, in nanoseconds */
+	long long	start;		/* start of the current period */
+	long long	deadline;	/* armed deadline */
+	int		armed;		/* `deadline' hasn't passed yet */
+	int		fd;		/* timerfd for `deadline', or -1 */
+	int		deadfd;		/* timerfd given up on, or -1 */
+};
+
+static long long	sched_now(void);
+
+/*
+ * Create a schedule of `msec'-millisecond periods, the first of which
+ * starts now.  If it returns, the pointer returned is guaranteed to be
+ * valid.
+ */
+sched_t *
+sched_create(unsigned int msec)
+{
+	sched_t *sp;
+
+	sp = malloc(sizeof (sched_t));
+	if (sp == NULL)
+		die("cannot allocate sampling schedule");
+
+	sp->interval = msec * WN_NSPERMS;
+	sp->start = sched_now();
+	sp->deadline = sp->start;
+	sp->armed = 0;
+	sp->fd = -1;
+	sp->deadfd = -1;
+
+	/*
+	 * If there's no timerfd (or it doesn't work), we just fall back to
+	 * working out the timeouts ourselves.
+	 */
+#if	defined(HAVE_SYS_TIMERFD_H) && defined(CLOCK_MONOTONIC)
+	sp->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
+	return (sp);
+}
+
+/*
+ * Destroy the schedule pointed to by `sp'.
+ */
+void
+sched_destroy(sched_t *sp)
+{
+	if (sp->fd != -1)
+		(void) close(sp->fd);
+	if (sp->deadfd != -1)
+		(void) close(sp->deadfd);
+	free(sp);
+}
+
+/*
+ * Parse the update interval `str', in (possibly fractional) seconds, into
+ * milliseconds at `msecp'.  Return 1 on success, 0 if it isn't a number
+ * or is out of range.
+ */
+int
+sched_parse(const char *str, unsigned int *msecp)
+{
+	double	secs;
+	char	*end;
+
+	secs = strtod(str, &end);
+	if (end == str || *end != '\0')
+		return (0);
+
+	/*
+	 * strtod() takes "nan", which fails every comparison below.
+	 */
+	if (secs != secs)
+		return (0);
+
+	secs = secs * 1000 + 0.5;
+	if (secs < WN_SCHED_MINMS || secs > WN_SCHED_MAXMS)
+		return (0);
+
+	*msecp = (unsigned int)secs;
+	return (1);
+}
+
+/*
+ * Return the descriptor that becomes readable when the armed deadline
+ * passes, or -1 if there isn't one (in which case, use sched_timeout()).
+ */
+int
+sched_fd(sched_t *sp)
+{
+	return (sp->fd);
+}
+
+/*
+ * Arm the schedule pointed to by `sp' for `offset' milliseconds into the
+ * current period.  Re-arming for a deadline that's still pending (as
+ * happens every time some other event interrupts the wait) is free.
+ * Return 1, or 0 if the timer wouldn't take the deadline, in which case
+ * the schedule falls back on sched_timeout() from then on: whoever is
+ * watching the descriptor sched_fd() returned should stop.  It's left
+ * open until sched_destroy(), so that its number isn't reused meanwhile.
+ */
+int
+sched_arm(sched_t *sp, unsigned int offset)
+{
+	long long deadline = sp->start + offset * WN_NSPERMS;
+#if	defined(HAVE_SYS_TIMERFD_H) && defined(CLOCK_MONOTONIC)
+	struct itimerspec its;
+#endif
+
+	if (sp->armed && deadline == sp->deadline)
+		return (1);
+
+	sp->deadline = deadline;
+	sp->armed = 1;
+
+#if	defined(HAVE_SYS_TIMERFD_H) && defined(CLOCK_MONOTONIC)
+	if (sp->fd == -1)
+		return (1);
+
+	/*
+	 * An all-zero it_value disarms the timer, so never ask for that.
+	 */
+	(void) memset(&its, 0, sizeof (its));
+	its.it_value.tv_sec = sp->deadline / WN_NSPERSEC;
+	its.it_value.tv_nsec = sp->deadline % WN_NSPERSEC;
+	if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+		its.it_value.tv_nsec = 1;
+
+	if (timerfd_settime(sp->fd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+		sp->deadfd = sp->fd;
+		sp->fd = -1;
+		return (0);
+	}
+#endif
+	return (1);
+}
+
+/*
+ * Return how many milliseconds remain until the armed deadline (rounded
+ * up, so that waiting that long is never too short), or -1 if the wait
+ * should instead be for sched_fd() to become readable.
+ */
+int
+sched_timeout(sched_t *sp)
+{
+	long long left;
+
+	if (sp->fd != -1)
+		return (-1);
+
+	left = sp->deadline - sched_now();
+	if (left <= 0)
+		return (0);
+
+	return ((left + WN_NSPERMS - 1) / WN_NSPERMS);
+}
+
+/*
+ * Return 1 if the armed deadline has passed, 0 otherwise.
+ */
+int
+sched_expired(sched_t *sp)
+{
+	unsigned long long expirations;
+
+	if (sp->fd != -1)
+		(void) read(sp->fd, &expirations, sizeof (expirations));
+
+	if (sched_now() < sp->deadline)
+		return (0);
+
+	sp->armed = 0;
+	return (1);
+}
+
+/*
+ * Wait for the armed deadline to pass.  Return 1 once it has, or 0 if
+ * the wait was interrupted by a signal first.
+ */
+int
+sched_wait(sched_t *sp)
+{
+	struct pollfd pfd;
+
+	while (!sched_expired(sp)) {
+		pfd.fd = sp->fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, sp->fd != -1, sched_timeout(sp)) == -1 &&
+		    errno == EINTR)
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * Move on to the next period of the schedule pointed to by `sp', and
+ * return the number of periods that had to be skipped to get there.
+ */
+unsigned int
+sched_next(sched_t *sp)
+{
+	long long	behind;
+	unsigned int	skipped = 0;
+
+	sp->start += sp->interval;
+
+	/*
+	 * If we've fallen a whole period or more behind (the machine was
+	 * too busy to run us, say), skip the periods we missed rather than
+	 * racing through them.
+	 */
+	behind = sched_now() - sp->start;
+	if (behind >= sp->interval) {
+		skipped = behind / sp->interval;
+		sp->start += skipped * sp->interval;
+	}
+	return (skipped);
+}
+
+/*
+ * Return the current time on the monotonic clock, in nanoseconds.
+ */
+static long long
+sched_now(void)
+{
+#ifdef	CLOCK_MONOTONIC
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * WN_NSPERSEC + ts.tv_nsec);
+#else
+	struct timeval tv;
+
+	(void) gettimeofday(&tv, NULL);
+	return (tv.tv_sec * WN_NSPERSEC + tv.tv_usec * 1000LL);
+#endif
+}
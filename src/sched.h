@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetload - A dockapp to monitor network interface usage.
+ *	       Inspired by Seiichi SATO's nifty CPU usage monitor.
+ *
+ * Sampling schedule interfaces.  A schedule is a series of periods, each
+ * exactly one interval long and starting exactly where the previous one
+ * ended, measured on the monotonic clock -- so that neither wall-clock
+ * changes nor time spent doing the sampling make the cadence drift.
+ * Within a period, deadlines are given as offsets from its start.
+ */
+
+#ifndef	WN_SCHED_H
+#define	WN_SCHED_H
+
+#pragma ident "@(#)sched.h	1.1	26/10/17 meem"
+
+#define	WN_SCHED_MINMS	10	/* shortest interval, in milliseconds */
+
+typedef struct sched sched_t;
+
+extern sched_t		*sched_create(unsigned int);
+extern void		sched_destroy(sched_t *);
+extern int		sched_parse(const char *, unsigned int *);
+extern int		sched_fd(sched_t *);
+extern int		sched_arm(sched_t *, unsigned int);
+extern int		sched_timeout(sched_t *);
+extern int		sched_expired(sched_t *);
+extern int		sched_wait(sched_t *);
+extern unsigned int	sched_next(sched_t *);
+
+#endif /* WN_SCHED_H */
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * wmnetcollect - The wmnetload rate engine, without the dockapp.
+ *
+ * Samples the same statistics sources and computes the same per-second
+ * rates as wmnetload, but rather than drawing them, streams them as CSV
+ * or JSON lines to stdout or a file.  Alternatively, it can quietly keep
+ * a compressed history of every sample, and write that out on demand.
+ * It can also write out the history in one of wmnetload's archives the
+ * same way.  Nothing in here may use X.
+ */
+
+#pragma ident "@(#)wmnetcollect.c	1.1	26/10/17 meem"
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ifarch.h"
+#include "ifhist.h"
+#include "ifinfo.h"
+#include "iflist.h"
+#include "ifstat.h"
+#include "sched.h"
+#include "utils.h"
+
+/*
+ * Output is accumulated here and handed to write(2) once every `batch'
+ * intervals (or whenever it fills up), so that a busy machine with lots
+ * of interfaces still only costs one system call per batch.
+ */
+#define	WC_OUTBUFSIZE	65536
+
+typedef enum { WC_CSV, WC_JSON } wcformat_t;
+
+typedef struct {
+	int		fd;			/* descriptor to write to */
+	size_t		len;			/* bytes buffered */
+	char		buf[WC_OUTBUFSIZE];	/* buffered output */
+} wcout_t;
+
+/*
+ * The interfaces being collected.  When no interfaces are named on the
+ * command line, every interface in each snapshot is collected, and new
+ * ones are added as they show up.
+ */
+typedef struct {
+	ifinfo_t	**ifps;		/* interfaces being collected */
+	unsigned int	nifs;		/* number of entries in `ifps' */
+	int		all;		/* collecting every interface */
+	ifstat_t	*statep;	/* statistics source */
+	unsigned int	interval;	/* nominal interval, in milliseconds */
+	unsigned int	histsecs;	/* history to keep, in seconds; 0 = */
+					/* none (write samples as they come) */
+} wcifs_t;
+
+static const char *ctrnames[WN_IFSTATS_NCTRS] = {
+	"rxbytes",	"txbytes",	"rxpackets",	"txpackets",
+	"rxerrors",	"txerrors",	"rxdrops",	"txdrops",
+	"rxfifo",	"txfifo",	"multicast"
+};
+
+static const char *statusnames[] = { "unknown", "up", "down" };
+
+static volatile sig_atomic_t done;
+static volatile sig_atomic_t dump;	/* history requested */
+
+static void	usage(void);
+static void	onsignal(int);
+static void	onusr1(int);
+static ifinfo_t	*wc_addif(wcifs_t *, const char *);
+static ifinfo_t	*wc_findif(wcifs_t *, unsigned int, const char *);
+static void	wc_collect(wcifs_t *, iflist_t *, const ifstatsnap_t *,
+    int, wcformat_t, const struct timeval *, wcout_t *);
+static void	wc_header(wcformat_t, wcout_t *);
+static void	wc_archive(const char *, wcformat_t, wcout_t *);
+static void	wc_history(wcifs_t *, int, wcformat_t, wcout_t *);
+static void	wc_record(wcifs_t *, wcformat_t, const struct timeval *,
+    ifinfo_t *, wcout_t *);
+static void	out_printf(wcout_t *, const char *, ...);
+static void	out_name(wcout_t *, wcformat_t, const char *);
+static void	out_flush(wcout_t *);
+
+int
+main(int argc, char **argv)
+{
+	static wcout_t	out;
+	wcifs_t		ifs = { NULL, 0, 0, NULL, 0, 0 };
+	wcformat_t	format = WC_CSV;
+	char		firstifname[IFNAMSIZ];
+	char		**ifnames;
+	unsigned int	nifnames = 0, i;
+	char		*source = WN_IFSTAT_DEFAULT;
+	char		*output = NULL;
+	char		*archive = NULL;
+	char		*end;
+	unsigned int	interval = 1000;
+	unsigned long	count = 0, batch = 1, n;
+	int		c, replay;
+	iflist_t	*iflp;
+	const ifstatops_t *statops;
+	const ifstatsnap_t *snap;
+	ifstat_t	*statep;
+	sched_t		*schedp;
+	struct sigaction act;
+	struct timeval	now;
+
+	progname = strrchr(argv[0], '/');
+	if (progname != NULL)
+		progname++;
+	else
+		progname = argv[0];
+
+	chpriv(PRIV_DROP);
+
+	/*
+	 * Interfaces named with -i are created once we know the statistics
+	 * source, so just remember their names for now.
+	 */
+	ifnames = calloc(argc, sizeof (char *));
+	if (ifnames == NULL)
+		die("cannot allocate interface names");
+
+	while ((c = getopt(argc, argv, "H:a:b:c:f:hi:o:s:u:")) != -1) {
+		switch (c) {
+		case 'H':
+			ifs.histsecs = strtoul(optarg, &end, 10);
+			if (*end != '\0' || ifs.histsecs == 0)
+				die("invalid history length %s\n", optarg);
+			break;
+		case 'a':
+			archive = optarg;
+			break;
+		case 'b':
+			batch = strtoul(optarg, &end, 10);
+			if (*end != '\0' || batch == 0)
+				die("invalid batch size %s\n", optarg);
+			break;
+		case 'c':
+			count = strtoul(optarg, &end, 10);
+			if (*end != '\0')
+				die("invalid count %s\n", optarg);
+			break;
+		case 'f':
+			if (strcmp(optarg, "csv") == 0)
+				format = WC_CSV;
+			else if (strcmp(optarg, "json") == 0)
+				format = WC_JSON;
+			else
+				die("unknown output format %s\n", optarg);
+			break;
+		case 'i':
+			if (strlen(optarg) >= IFNAMSIZ)
+				die("interface name %s is too long\n", optarg);
+			ifnames[nifnames++] = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 's':
+			source = optarg;
+			break;
+		case 'u':
+			if (!sched_parse(optarg, &interval))
+				die("invalid update interval %s\n", optarg);
+			break;
+		case 'h':
+		default:
+			usage();
+		}
+	}
+
+	if (optind != argc)
+		usage();
+
+	out.fd = STDOUT_FILENO;
+	if (output != NULL) {
+		out.fd = open(output, O_WRONLY|O_CREAT|O_APPEND, 0644);
+		if (out.fd == -1)
+			die("cannot open %s\n", output);
+	}
+
+	if (archive != NULL) {
+		wc_archive(archive, format, &out);
+		out_flush(&out);
+		return (EXIT_SUCCESS);
+	}
+
+	iflp = iflist_init();
+	if (iflp == NULL)
+		die("cannot initialize interface list\n");
+
+	/*
+	 * Probe with the first named interface, if there is one, since
+	 * that's what we'll be sampling.
+	 */
+	if (nifnames > 0)
+		(void) strcpy(firstifname, ifnames[0]);
+	else if (!iflist_next(iflp, NULL, firstifname))
+		die("no interfaces available\n");
+
+	statops = if_statlookup(source, firstifname);
+	if (statops == NULL)
+		die("unknown statistics source %s\n", source);
+
+	statep = if_statinit(statops);
+	if (statep == NULL)
+		die("cannot initialize %s statistics\n", statops->name);
+
+	ifs.statep = statep;
+	ifs.all = (nifnames == 0);
+	ifs.interval = interval;
+	for (i = 0; i < nifnames; i++)
+		(void) wc_addif(&ifs, ifnames[i]);
+	free(ifnames);
+
+	/*
+	 * Stop cleanly on the usual signals, so that whatever has been
+	 * buffered still makes it out.
+	 */
+	(void) memset(&act, 0, sizeof (act));
+	act.sa_handler = onsignal;
+	(void) sigemptyset(&act.sa_mask);
+	(void) sigaction(SIGINT, &act, NULL);
+	(void) sigaction(SIGTERM, &act, NULL);
+	(void) sigaction(SIGHUP, &act, NULL);
+	act.sa_handler = onusr1;
+	(void) sigaction(SIGUSR1, &act, NULL);
+
+	/*
+	 * A source that serves recorded samples has its own clock; run
+	 * through it as fast as it can be read.
+	 */
+	replay = (if_statclock(statep, &now) != 0);
+
+	/*
+	 * Take the first sample, which just sets the baseline.
+	 */
+	snap = if_statsall(statep);
+	if (snap == NULL)
+		die("cannot read interface statistics\n");
+	wc_collect(&ifs, iflp, snap, 0, format, NULL, &out);
+
+	/*
+	 * Each sample is taken at the end of a period of the schedule.
+	 */
+	schedp = sched_create(interval);
+	(void) sched_arm(schedp, interval);
+
+	if (ifs.histsecs == 0)
+		wc_header(format, &out);
+	for (n = 0; !done && (count == 0 || n < count); n++) {
+		/*
+		 * Asking for the history (with SIGUSR1) interrupts the
+		 * wait for the next sample, but doesn't skip it.
+		 */
+		if (!replay) {
+			while (!done && !sched_wait(schedp)) {
+				if (dump) {
+					dump = 0;
+					wc_history(&ifs, replay, format, &out);
+					out_flush(&out);
+				}
+			}
+			if (done)
+				break;
+			(void) sched_next(schedp);
+			(void) sched_arm(schedp, interval);
+		}
+
+		(void) iflist_update(iflp);
+
+		snap = if_statsall(statep);
+		if (if_statclock(statep, &now) == -1)
+			break;
+
+		if (snap == NULL) {
+			warn("cannot read interface statistics\n");
+			continue;
+		}
+
+		if (!replay)
+			(void) gettimeofday(&now, NULL);
+
+		wc_collect(&ifs, iflp, snap, ifs.histsecs == 0, format, &now,
+		    &out);
+		if ((n + 1) % batch == 0)
+			out_flush(&out);
+	}
+
+	if (ifs.histsecs != 0)
+		wc_history(&ifs, replay, format, &out);
+	out_flush(&out);
+
+	if (output != NULL)
+		(void) close(out.fd);
+
+	while (ifs.nifs > 0)
+		ifinfo_destroy(ifs.ifps[--ifs.nifs]);
+	free(ifs.ifps);
+	sched_destroy(schedp);
+	if_statfini(statep);
+	iflist_fini(iflp);
+	return (EXIT_SUCCESS);
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "Usage: %s [options]\n\n"
+	    "  -i IFNAME   collect IFNAME (may be repeated; default is all)\n"
+	    "  -u SECS     update interval in seconds, down to 0.01 "
+	    "(default 1)\n"
+	    "  -c COUNT    stop after COUNT intervals (default never)\n"
+	    "  -f FORMAT   output format, csv (default) or json\n"
+	    "  -o FILE     append output to FILE rather than stdout\n"
+	    "  -b BATCH    intervals to buffer between writes (default 1)\n"
+	    "  -s SOURCE   statistics source (default %s)\n"
+	    "  -H SECS     keep SECS of history, and only write it out on\n"
+	    "              SIGUSR1 and on exit\n"
+	    "  -a FILE     write out the history in archive FILE, and exit\n"
+	    "  -h          display this help\n", progname, WN_IFSTAT_DEFAULT);
+	exit(EXIT_FAILURE);
+}
+
+static void
+onsignal(int sig)
+{
+	(void) sig;
+	done = 1;
+}
+
+static void
+onusr1(int sig)
+{
+	(void) sig;
+	dump = 1;
+}
+
+/*
+ * Add an interface named `ifname' to `ifsp', along with its history if
+ * we're keeping them.
+ */
+static ifinfo_t *
+wc_addif(wcifs_t *ifsp, const char *ifname)
+{
+	ifinfo_t **ifps;
+
+	ifps = realloc(ifsp->ifps, (ifsp->nifs + 1) * sizeof (ifinfo_t *));
+	if (ifps == NULL)
+		die("cannot allocate interface table");
+
+	ifsp->ifps = ifps;
+	ifps[ifsp->nifs] = ifinfo_create(ifname, ifsp->statep);
+	if (ifsp->histsecs != 0)
+		ifps[ifsp->nifs]->hist = ifhist_create(ifsp->histsecs);
+	return (ifps[ifsp->nifs++]);
+}
+
+/*
+ * Find the interface named `ifname' in `ifsp'.  Snapshots tend to list
+ * interfaces in the same order every time, so try slot `hint' first.
+ */
+static ifinfo_t *
+wc_findif(wcifs_t *ifsp, unsigned int hint, const char *ifname)
+{
+	unsigned int i;
+
+	if (hint < ifsp->nifs && strcmp(ifsp->ifps[hint]->name, ifname) == 0)
+		return (ifsp->ifps[hint]);
+
+	for (i = 0; i < ifsp->nifs; i++) {
+		if (strcmp(ifsp->ifps[i]->name, ifname) == 0)
+			return (ifsp->ifps[i]);
+	}
+	return (NULL);
+}
+
+/*
+ * Fold the snapshot `snap' (the last one taken through `ifsp->statep')
+ * into the interfaces in `ifsp'; if `emit' is set, write out a record for
+ * each of them stamped with `tvp'.  An interface seen for the first time
+ * only sets its baseline.
+ */
+static void
+wc_collect(wcifs_t *ifsp, iflist_t *iflp, const ifstatsnap_t *snap,
+    int emit, wcformat_t format, const struct timeval *tvp, wcout_t *outp)
+{
+	const ifstatent_t	*entp;
+	ifinfo_t		*ifp;
+	ifsample_t		sample;
+	unsigned int		i;
+
+	if (!ifsp->all) {
+		for (i = 0; i < ifsp->nifs; i++) {
+			ifp = ifsp->ifps[i];
+			if (ifinfo_snapsample(ifp, iflp, snap, &sample))
+				ifinfo_update(ifp, &sample);
+			else
+				ifinfo_update(ifp, &ifp->last);
+			if (emit)
+				wc_record(ifsp, format, tvp, ifp, outp);
+		}
+		return;
+	}
+
+	sample.stamp = if_statstamp(ifsp->statep);
+	for (i = 0; i < snap->nents; i++) {
+		entp = &snap->ents[i];
+		sample.stats = entp->stats;
+		sample.ifindex = entp->ifindex;
+		ifp = wc_findif(ifsp, i, entp->name);
+		if (ifp == NULL) {
+			ifp = wc_addif(ifsp, entp->name);
+			ifinfo_update(ifp, &sample);
+			continue;
+		}
+
+		ifp->status = if_status(iflp, ifp->name, entp->flags);
+		ifinfo_update(ifp, &sample);
+		if (emit)
+			wc_record(ifsp, format, tvp, ifp, outp);
+	}
+}
+
+/*
+ * Write out the header, if `format' has one.
+ */
+static void
+wc_header(wcformat_t format, wcout_t *outp)
+{
+	unsigned int i;
+
+	if (format != WC_CSV)
+		return;
+
+	out_printf(outp, "time,interface,status");
+	for (i = 0; i < WN_IFSTATS_NCTRS; i++)
+		out_printf(outp, ",%s", ctrnames[i]);
+	out_printf(outp, ",jitter");
+	for (i = 0; i < WN_IFWIN_NWINS; i++)
+		out_printf(outp, ",avg%u", ifwin_secs[i]);
+	out_printf(outp, "\n");
+}
+
+/*
+ * Write out the history in the archive at `path', in `format': for each
+ * of its tiers (finest first) and each step still in it (oldest first),
+ * the average bytes per second received and sent over the part of the
+ * step that was sampled, and the highest rates sampled during it.
+ */
+static void
+wc_archive(const char *path, wcformat_t format, wcout_t *outp)
+{
+	ifarch_t	*archp;
+	const ifahdr_t	*hdrp;
+	const ifarow_t	*rowp;
+	const ifatier_t	*tierp;
+	unsigned int	i, j;
+	time_t		now, when;
+	double		secs;
+
+	archp = ifarch_open(path, NULL);
+	if (archp == NULL)
+		die("cannot read archive %s\n", path);
+
+	hdrp = ifarch_header(archp);
+	if (format == WC_CSV) {
+		out_printf(outp, "time,interface,step,rxbytes,txbytes,rxpeak,"
+		    "txpeak\n");
+	}
+
+	now = time(NULL);
+	for (i = 0; i < hdrp->ntiers; i++) {
+		tierp = &hdrp->tiers[i];
+		for (j = tierp->nrows; j-- > 0; ) {
+			when = now - (time_t)j * tierp->step;
+			rowp = ifarch_row(archp, i, when);
+			if (rowp == NULL || rowp->msecs == 0)
+				continue;
+
+			secs = rowp->msecs / 1e3;
+			if (format == WC_CSV) {
+				out_printf(outp, "%ld,", (long)rowp->stamp);
+				out_name(outp, format, hdrp->ifname);
+				out_printf(outp, ",%u,%.3f,%.3f,%.3f,%.3f\n",
+				    tierp->step, rowp->rxbytes / secs,
+				    rowp->txbytes / secs, rowp->rxpeak,
+				    rowp->txpeak);
+			} else {
+				out_printf(outp, "{\"time\":%ld,"
+				    "\"interface\":", (long)rowp->stamp);
+				out_name(outp, format, hdrp->ifname);
+				out_printf(outp, ",\"step\":%u,"
+				    "\"rxbytes\":%.3f,\"txbytes\":%.3f,"
+				    "\"rxpeak\":%.3f,\"txpeak\":%.3f}\n",
+				    tierp->step,
+				    rowp->rxbytes / secs, rowp->txbytes / secs,
+				    rowp->rxpeak, rowp->txpeak);
+			}
+		}
+	}
+
+	ifarch_close(archp);
+}
+
+/*
+ * Write out the history of each interface in `ifsp', in `format': the
+ * bytes per second received and sent between each pair of samples in it,
+ * as of the time of the later one.  Samples are stamped on the monotonic
+ * clock, so unless `replay'ing (in which case the clocks are one and the
+ * same), that's turned into the time of day as of now.
+ */
+static void
+wc_history(wcifs_t *ifsp, int replay, wcformat_t format, wcout_t *outp)
+{
+	ifinfo_t	*ifp;
+	ifhiter_t	iter;
+	ulonglong_t	stamp, rx, tx, ostamp, orx, otx;
+	long long	offset = 0, ns;
+	struct timeval	mono, wall;
+	double		secs;
+	unsigned int	i;
+
+	if (!replay) {
+		(void) if_statclock(ifsp->statep, &mono);
+		(void) gettimeofday(&wall, NULL);
+		offset = (wall.tv_sec - mono.tv_sec) * 1000000000LL +
+		    (wall.tv_usec - mono.tv_usec) * 1000LL;
+	}
+
+	if (format == WC_CSV)
+		out_printf(outp, "time,interface,rxbytes,txbytes\n");
+
+	for (i = 0; i < ifsp->nifs; i++) {
+		ifp = ifsp->ifps[i];
+		ifhist_iter(ifp->hist, &iter);
+		if (!ifhist_next(&iter, &ostamp, &orx, &otx))
+			continue;
+
+		for (; ifhist_next(&iter, &stamp, &rx, &tx); ostamp = stamp,
+		    orx = rx, otx = tx) {
+			if (stamp == ostamp)
+				continue;
+
+			secs = (stamp - ostamp) / 1e9;
+			ns = stamp + offset;
+			if (format == WC_CSV) {
+				out_printf(outp, "%lld.%03lld,", ns /
+				    1000000000LL, ns / 1000000 % 1000);
+				out_name(outp, format, ifp->name);
+				out_printf(outp, ",%.3f,%.3f\n",
+				    (rx - orx) / secs, (tx - otx) / secs);
+			} else {
+				out_printf(outp, "{\"time\":%lld.%03lld,"
+				    "\"interface\":", ns / 1000000000LL,
+				    ns / 1000000 % 1000);
+				out_name(outp, format, ifp->name);
+				out_printf(outp, ",\"rxbytes\":%.3f,"
+				    "\"txbytes\":%.3f}\n", (rx - orx) / secs,
+				    (tx - otx) / secs);
+			}
+		}
+	}
+}
+
+/*
+ * Write out the per-second rates for the interface described by `ifp'
+ * as of time `tvp', along with how far (in milliseconds) the time they
+ * were measured over strayed from the nominal interval of `ifsp'.  If
+ * no time was measured (the sample failed), there's no jitter to speak
+ * of.  Finally, write out the bytes per second (received and sent) over
+ * each rolling window.
+ */
+static void
+wc_record(wcifs_t *ifsp, wcformat_t format, const struct timeval *tvp,
+    ifinfo_t *ifp, wcout_t *outp)
+{
+	double		*rates = (double *)&ifp->rate;
+	double		jitter = 0.0;
+	double		avgs[WN_IFWIN_NWINS], rx, tx;
+	unsigned int	i;
+
+	for (i = 0; i < WN_IFWIN_NWINS; i++) {
+		(void) ifinfo_window(ifp, i, &rx, &tx);
+		avgs[i] = rx + tx;
+	}
+
+	if (ifp->elapsed != 0)
+		jitter = ifp->elapsed / 1e6 - ifsp->interval;
+
+	if (format == WC_CSV) {
+		out_printf(outp, "%ld.%06ld,", (long)tvp->tv_sec,
+		    (long)tvp->tv_usec);
+		out_name(outp, format, ifp->name);
+		out_printf(outp, ",%s", statusnames[ifp->status]);
+		for (i = 0; i < WN_IFSTATS_NCTRS; i++)
+			out_printf(outp, ",%.3f", rates[i]);
+		out_printf(outp, ",%.3f", jitter);
+		for (i = 0; i < WN_IFWIN_NWINS; i++)
+			out_printf(outp, ",%.3f", avgs[i]);
+	} else {
+		out_printf(outp, "{\"time\":%ld.%06ld,\"interface\":",
+		    (long)tvp->tv_sec, (long)tvp->tv_usec);
+		out_name(outp, format, ifp->name);
+		out_printf(outp, ",\"status\":\"%s\"",
+		    statusnames[ifp->status]);
+		for (i = 0; i < WN_IFSTATS_NCTRS; i++) {
+			out_printf(outp, ",\"%s\":%.3f", ctrnames[i],
+			    rates[i]);
+		}
+		out_printf(outp, ",\"jitter\":%.3f", jitter);
+		for (i = 0; i < WN_IFWIN_NWINS; i++) {
+			out_printf(outp, ",\"avg%u\":%.3f", ifwin_secs[i],
+			    avgs[i]);
+		}
+		out_printf(outp, "}");
+	}
+	out_printf(outp, "\n");
+}
+
+/*
+ * Buffer up the printf-style output described by `fmt' in `outp',
+ * flushing first if there isn't room for it.
+ */
+/* PRINTFLIKE2 */
+static void
+out_printf(wcout_t *outp, const char *fmt, ...)
+{
+	va_list	alist;
+	int	len;
+
+	for (;;) {
+		va_start(alist, fmt);
+		len = vsnprintf(outp->buf + outp->len,
+		    sizeof (outp->buf) - outp->len, fmt, alist);
+		va_end(alist);
+
+		if (len < 0)
+			die("cannot format output\n");
+
+		if (outp->len + len < sizeof (outp->buf))
+			break;
+
+		if (outp->len == 0)
+			die("output record too long\n");
+		out_flush(outp);
+	}
+	outp->len += len;
+}
+
+/*
+ * Buffer up interface name `name', quoted as `format' requires.  Names
+ * can contain just about anything other than slashes and whitespace.
+ */
+static void
+out_name(wcout_t *outp, wcformat_t format, const char *name)
+{
+	const char *cp;
+
+	if (format == WC_CSV) {
+		if (strpbrk(name, ",\"") == NULL) {
+			out_printf(outp, "%s", name);
+			return;
+		}
+		out_printf(outp, "\"");
+		for (cp = name; *cp != '\0'; cp++) {
+			if (*cp == '"')
+				out_printf(outp, "\"");
+			out_printf(outp, "%c", *cp);
+		}
+		out_printf(outp, "\"");
+		return;
+	}
+
+	out_printf(outp, "\"");
+	for (cp = name; *cp != '\0'; cp++) {
+		if (*cp == '"' || *cp == '\\')
+			out_printf(outp, "\\%c", *cp);
+		else if ((unsigned char)*cp < 0x20)
+			out_printf(outp, "\\u%04x", (unsigned char)*cp);
+		else
+			out_printf(outp, "%c", *cp);
+	}
+	out_printf(outp, "\"");
+}
+
+/*
+ * Write out everything buffered in `outp'.
+ */
+static void
+out_flush(wcout_t *outp)
+{
+	size_t	off;
+	ssize_t	len;
+
+	for (off = 0; off < outp->len; off += len) {
+		len = write(outp->fd, outp->buf + off, outp->len - off);
+		if (len == -1) {
+			if (errno == EINTR) {
+				len = 0;
+				continue;
+			}
+			die("cannot write output\n");
+		}
+	}
+	outp->len = 0;
+}
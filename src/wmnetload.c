@@ -25,27 +25,30 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <net/if.h>
-#include <netinet/in.h>
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
 #include <math.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/ioctl.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include <dockapp.h>
-#ifdef HAVE_SYS_SOCKIO_H
-#include <sys/sockio.h>
-#endif
-#ifdef HAVE_ALLOCA_H
-#include <alloca.h>
-#endif
 
+#include "burst.h"
+#include "evloop.h"
+#include "ifarch.h"
+#include "ifgraph.h"
+#include "ifinfo.h"
+#include "iflist.h"
+#include "ifrec.h"
 #include "ifstat.h"
+#include "ifstate.h"
+#include "sched.h"
 #include "utils.h"
 #include "pixmaps.h"
 
@@ -55,6 +58,18 @@
 #define	WN_XCopyArea(s, d, w, h, x, y) \
 	XCopyArea(DADisplay, s, d, DAGC, x, y, w, h, x, y)
 
+#ifdef	WN_RENDER_STATS
+/*
+ * When gathering rendering statistics for the render benchmark (see
+ * xbench.sh), keep track of who issues each XCopyArea().
+ */
+#define	XCopyArea(dpy, s, d, gc, sx, sy, w, h, dx, dy) \
+	(rs_copyarea(__func__), \
+	(XCopyArea)(dpy, s, d, gc, sx, sy, w, h, dx, dy))
+
+#define	WN_RS_MAXFUNCS	16	/* most functions we track */
+#endif
+
 /*
  * Make it easy to increment and decrement an integer modulo a value.
  */
@@ -67,6 +82,11 @@
  */
 #define	WN_DEF_BPS2BAR	(150 * 125 / WN_COL_HEIGHT)
 
+/*
+ * How often to save warm-start state, in nanoseconds, besides on exit.
+ */
+#define	WN_STATE_SAVENS	(60 * 1000000000LL)
+
 /*
  * Flags for draw_dockapp().
  */
@@ -74,6 +94,7 @@ enum {
 	WN_DRAWBPS	= 0x01,	/* Draw just the bps value */
 	WN_DRAWGRAPH	= 0x02,	/* Draw just the graph */
 	WN_DRAWIFNAME	= 0x04, /* Draw interface name */
+	WN_DRAWSCROLL	= 0x08,	/* Draw just the graph's new columns */
 	WN_DRAWALL	= 0xff	/* Draw everything */
 };
 
@@ -85,6 +106,17 @@ enum {
 	WN_BP_REDRAW	= 0x02	/* redraw dockapp */
 };
 
+/*
+ * Return values for nextevent(); the ones for descriptors double as their
+ * event loop tokens.
+ */
+enum {
+	WN_EV_NONE,		/* nothing to do yet */
+	WN_EV_TIMEOUT,		/* timeout expired */
+	WN_EV_X,		/* X event arrived */
+	WN_EV_IFLIST		/* interface list may have changed */
+};
+
 /*
  * Flags associated with the display.
  */
@@ -97,47 +129,37 @@ enum {
 	WN_DISP_BACKLIT	= 0x11	/* WN_DISP_ALARM | WN_DISP_LIGHT */
 };
 
-typedef enum { IF_UNKNOWN, IF_UP, IF_DOWN } ifstatus_t;
-
-typedef struct {
-	ulonglong_t	bps2bar;		/* bps -> bar conversion */
-	ulonglong_t	rbars[WN_GR_COLS];	/* receive bars */
-	ulonglong_t	tbars[WN_GR_COLS];	/* transmit bars */
-	ifstats_t	stats[WN_GR_COLS];	/* unscaled stats, in bps */
-	unsigned int	col;			/* current column in graph */
-	unsigned int	maxcol;			/* column controlling bps2bar */
-} ifgraph_t;
-
-typedef struct {
-	char		*name;			/* interface name */
-	ifstatus_t	status;			/* current status */
-	ulonglong_t	bps;			/* current bps */
-	ifgraph_t	*graph;			/* interface stats graph */
-	ifstatstate_t	*statep;		/* pointer to interface state */
-} ifinfo_t;
-
 static void	draw_bps(ulonglong_t, Pixmap);
 static void	draw_digit(unsigned int, unsigned int, Pixmap);
 static void	draw_decimal(unsigned int, Pixmap);
 static void	draw_speed(unsigned int, Pixmap);
 static void	draw_graph(ifgraph_t *, Pixmap);
+static void	draw_scroll(ifgraph_t *, unsigned int, Pixmap, Pixmap);
+static void	draw_column(const ifgcol_t *, unsigned int, Pixmap);
 static void	draw_dockapp(ifinfo_t *, unsigned int, Pixmap);
+static void	draw_window(unsigned int, Pixmap);
+static unsigned int draw_changed(ifinfo_t *, unsigned int, Pixmap);
+static int	draw_event(XEvent *, Pixmap);
 static void	draw_ifname(const char *, Pixmap);
 static void	setshape(void);
 static int	xpm2pixmap(void);
 static void	buttonpress(int, int, int, int);
-static ifinfo_t *ifinfo_create(const char *);
-static void	ifinfo_destroy(ifinfo_t *);
-static void	ifinfo_monitor(ifinfo_t *, int, unsigned int, int, Pixmap);
-static ifstatus_t if_status(int, const char *);
-static int	if_flags(int, const char *);
-static int	if_next(int, const char *, char *);
-static void	next_bps(double [], unsigned int, unsigned int, ifinfo_t *);
-static unsigned int next_timeout(unsigned int[], unsigned int,
-    struct timeval *, unsigned int);
-static double *smoothtable_init(unsigned int);
-static unsigned int *timetable_init(double [], unsigned int, unsigned int);
+static ifinfo_t *ifdisp_create(const char *, ifstat_t *);
+static void	ifdisp_destroy(ifinfo_t *);
+static int	ifdisp_sample(ifinfo_t *, iflist_t *, ifsample_t *);
+static void	ifinfo_monitor(ifinfo_t *, iflist_t *, unsigned int,
+    unsigned int, Pixmap);
+static int	nextevent(XEvent *, sched_t *);
 static unsigned long getblendedcolor(const char *, int);
+static long long nsnow(void);
+static void	onusr1(int);
+static void	onquit(int);
+static void	state_save(void);
+static void	wakeup_report(void);
+#ifdef	WN_RENDER_STATS
+static void	rs_copyarea(const char *);
+static void	rs_report(void);
+#endif
 
 static Pixmap backlight_on, backlight_off, backlight_err, backlight_down;
 static Pixmap backlight_down_on, backlight_down_off, parts, font;
@@ -146,7 +168,9 @@ static char *desc = "\nNetwork interface usage monitor.\n";
 static char *vers = "wmnetload "VERSION" by meem@gnu.org -- compiled "__DATE__;
 
 enum { OPT_DISPLAY, OPT_BACKLIGHT, OPT_LIGHTCOLOR, OPT_UPDATE, OPT_INTERFACE,
-       OPT_NOIFNAME, OPT_SMOOTHING, OPT_BYTES, OPT_ALARM, OPT_KEEP, OPT_MAX };
+       OPT_NOIFNAME, OPT_SMOOTHING, OPT_BYTES, OPT_ALARM, OPT_KEEP, OPT_SOURCE,
+       OPT_RECORD, OPT_ADAPTIVE, OPT_BURST, OPT_SCALEPEAK, OPT_WINDOW,
+       OPT_ARCHIVE, OPT_STATE, OPT_MAX };
 
 extern int d_windowed;		/* grr; should be in <dockapp.h> */
 
@@ -155,7 +179,8 @@ static DAProgramOption options[] = {
 	{ "-bl", "--backlight", "turns on backlight", DONone },
 	{ "-lc", "--lightcolor", "sets backlight color (default: #6EC63B)",
 	  DOString },
-	{ "-u", "--update", "sets update interval (in seconds)", DOInteger },
+	{ "-u", "--update", "sets update interval (in seconds, down to 0.01)",
+	  DOString },
 	{ "-i", "--interface", "sets interface to monitor", DOString },
 	{ "-n", "--no-ifname", "does not display interface name", DONone },
 	{ "-s", "--smooth", "sets smoothing value (experimental)", DOInteger },
@@ -163,7 +188,24 @@ static DAProgramOption options[] = {
 	{ "-a", "--alarm", "activates alarm mode. <number> is in kbits/sec\n"
 	  "\t\t\t\t(or kbytes/sec if -b is specified)", DOInteger },
 	{ "-k", "--keep-ifname", "keep interface name even if not found",
-	  DONone }
+	  DONone },
+	{ "-ss", "--stats-source", "sets statistics source, or \"auto\" to\n"
+	  "\t\t\t\tpick the cheapest (default: "WN_IFSTAT_DEFAULT")",
+	  DOString },
+	{ "-rec", "--record", "records every sample to a trace file",
+	  DOString },
+	{ "-ad", "--adaptive", "samples faster while busy, slower while idle",
+	  DONone },
+	{ "-bu", "--burst", "also samples every <number> msecs in a thread\n"
+	  "\t\t\t\tof its own, to catch each column's peak", DOInteger },
+	{ "-sp", "--scale-peak", "scales the graph to fit peaks, not averages",
+	  DONone },
+	{ "-w", "--window", "shows (and alarms on) the average over the\n"
+	  "\t\t\t\tlast 1, 10, 60 or 300 seconds", DOInteger },
+	{ "-ar", "--archive", "keeps a month of each interface's history\n"
+	  "\t\t\t\tin the given directory", DOString },
+	{ "-st", "--state", "saves the graph and counters to the given file,\n"
+	  "\t\t\t\tto carry on from after a restart", DOString }
 };
 
 static DACallbacks callbacks = { NULL, buttonpress };
@@ -177,20 +219,85 @@ static unsigned int	bpflags;	/* flags set by buttonpress() */
 static double		*smoothtable;
 static unsigned int	*timetable;
 static ulonglong_t	alarmthresh;	/* in bits per second; 0 = none */
+static int		meterwin = -1;	/* rolling window shown; -1 = none */
 static char		*lightcolor;
+static ifrec_t		*recp;		/* trace being recorded, if any */
+static evloop_t		*evp;		/* X, timer and interface list events */
+static const ifstatops_t *burstops;	/* source for microbursts, if any */
+static unsigned int	burstms;	/* microburst sampling period */
+static burst_t		*burstp;	/* microburst sampler, if running */
+static char		*archdir;	/* directory of archives, if any */
+static ifarch_t		*archp;		/* interface's archive, if any */
+static char		*statepath;	/* warm-start state file, if any */
+static ifinfo_t		*stateifp;	/* interface whose state is saved */
+static unsigned int	stateinterval;	/* update interval it's saved with */
+static const char	*statebackend;	/* backend it's sampled by */
+static long long	statesaved;	/* when it was last saved */
+
+/*
+ * What the last frame drawn showed, so that one that would look just the
+ * same can be skipped.
+ */
+static struct {
+	int		valid;		/* a frame has been drawn */
+	unsigned int	dispflags;	/* display flags used */
+	Pixmap		background;	/* background pixmap used */
+	ifstatus_t	status;		/* interface status shown */
+	const char	*ifname;	/* interface name shown */
+	bpslayout_t	layout;		/* bps meter shown */
+	unsigned char	tbars[WN_GR_COLS]; /* transmit bars, newest first */
+	unsigned char	rbars[WN_GR_COLS]; /* receive bars, newest first */
+	unsigned char	tpeaks[WN_GR_COLS]; /* transmit peaks, newest first */
+	unsigned char	rpeaks[WN_GR_COLS]; /* receive peaks, newest first */
+	unsigned int	col;		/* graph's current column */
+	unsigned int	scroll;		/* columns it moved along by */
+} lastframe;
+
+/*
+ * How much work we've done; reported on SIGUSR1.
+ */
+static struct {
+	long long	start;		/* when we started, in nanoseconds */
+	unsigned long	samples;	/* samples taken */
+	unsigned long	frames;		/* frames drawn */
+	unsigned long	skipped;	/* frames skipped as unchanged */
+} wstats;
+static volatile sig_atomic_t	wreport;	/* report requested */
+static volatile sig_atomic_t	wquit;		/* exit requested */
+static int		obscured;	/* window is fully obscured */
+
+#ifdef	WN_RENDER_STATS
+static struct {
+	unsigned long	frames;		/* frames drawn */
+	unsigned long	requests;	/* X requests issued drawing them */
+	long long	ns;		/* time spent drawing them */
+	const char	*funcs[WN_RS_MAXFUNCS];	/* who called XCopyArea() */
+	unsigned long	copies[WN_RS_MAXFUNCS];	/* how often each did */
+	unsigned int	nfuncs;		/* number of entries in `funcs' */
+} rstats;
+#endif
 
 int
 main(int argc, char **argv)
 {
 	XTextProperty	name;
+	XWindowAttributes attrs;
+	struct sigaction act;
 	char		nextifname[IFNAMSIZ];
 	char		*ifname;
 	char		*display;
+	char		*source;
+	char		*record;
+	char		*update;
 	int		niter;
-	int		interval;
+	unsigned int	interval;
 	int		alarm;
-	int		siocfd;
+	int		burst;
+	int		window;
+	iflist_t	*iflp;
 	ifinfo_t	*ifp;
+	const ifstatops_t *statops;
+	ifstat_t	*statep;
 	Pixmap		pixmap;
 
 	bzero(nextifname, IFNAMSIZ);
@@ -204,23 +311,29 @@ main(int argc, char **argv)
 
 	options[OPT_DISPLAY].value.string	= &display;
 	options[OPT_INTERFACE].value.string	= &ifname;
-	options[OPT_UPDATE].value.integer	= &interval;
+	options[OPT_UPDATE].value.string	= &update;
 	options[OPT_SMOOTHING].value.integer	= &niter;
 	options[OPT_ALARM].value.integer	= &alarm;
 	options[OPT_LIGHTCOLOR].value.string	= &lightcolor;
+	options[OPT_SOURCE].value.string	= &source;
+	options[OPT_RECORD].value.string	= &record;
+	options[OPT_BURST].value.integer	= &burst;
+	options[OPT_WINDOW].value.integer	= &window;
+	options[OPT_ARCHIVE].value.string	= &archdir;
+	options[OPT_STATE].value.string		= &statepath;
 
 	DAParseArguments(argc, argv, options, OPT_MAX, desc, vers);
 
-	siocfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
-	if (siocfd == -1)
-		die("cannot open datagram socket");
+	iflp = iflist_init();
+	if (iflp == NULL)
+		die("cannot initialize interface list\n");
 
-	if (!if_next(siocfd, NULL, nextifname))
+	if (!iflist_next(iflp, NULL, nextifname))
 		die("no interfaces available\n");
 
 	if (!options[OPT_INTERFACE].used) {
 		ifname = nextifname;
-	} else if (if_status(siocfd, ifname) == IF_UNKNOWN) {
+	} else if (if_status(iflp, ifname, -1) == IF_UNKNOWN) {
 		if (!options[OPT_KEEP].used) {
 			warn("unknown interface %s; defaulting to %s\n", ifname,
 			    nextifname);
@@ -231,8 +344,30 @@ main(int argc, char **argv)
 	if (!options[OPT_DISPLAY].used)
 		display = "";
 
+	if (!options[OPT_SOURCE].used)
+		source = WN_IFSTAT_DEFAULT;
+
+	statops = if_statlookup(source, ifname);
+	if (statops == NULL)
+		die("unknown statistics source %s\n", source);
+
+	if (options[OPT_RECORD].used) {
+		recp = ifrec_open(record);
+		if (recp == NULL)
+			die("cannot record to %s\n", record);
+	}
+
 	if (!options[OPT_UPDATE].used)
-		interval = 1;
+		interval = 1000;
+	else if (!sched_parse(update, &interval))
+		die("invalid update interval %s\n", update);
+
+	if (options[OPT_BURST].used) {
+		if (burst < WN_BURST_MINMS || (unsigned int)burst >= interval)
+			die("invalid microburst sampling period %d\n", burst);
+		burstops = statops;
+		burstms = burst;
+	}
 
 	if (options[OPT_BACKLIGHT].used)
 		dispflags |= WN_DISP_LIGHT;
@@ -250,6 +385,11 @@ main(int argc, char **argv)
 			alarmthresh = alarm * 1000 / 8;
 	}
 
+	if (options[OPT_WINDOW].used) {
+		if (window < 0 || (meterwin = ifinfo_winlookup(window)) == -1)
+			die("invalid rolling window %d\n", window);
+	}
+
 	if (!options[OPT_SMOOTHING].used)
 		niter = 1;
 
@@ -257,13 +397,18 @@ main(int argc, char **argv)
 	if (smoothtable == NULL)
 		die("cannot create smoothing table");
 
-	timetable = timetable_init(smoothtable, interval * 1000, niter);
+	timetable = timetable_init(smoothtable, interval, niter);
 	if (timetable == NULL)
 		die("cannot create time smoothing table");
 
 	DAInitialize(display, argv[0], WN_DA_WIDTH, WN_DA_HEIGHT, argc, argv);
 	DASetCallbacks(&callbacks);
 
+#ifdef	WN_RENDER_STATS
+	if (atexit(rs_report) != 0)
+		warn("cannot arrange to report rendering statistics\n");
+#endif
+
 	/*
 	 * Set our WM_NAME property, since DAInitialize() forgot to and it
 	 * needs to be set so that AfterStep's wharf can swallow it.
@@ -285,15 +430,74 @@ main(int argc, char **argv)
 	DAShow();
 
 	/*
-	 * NOTE: ifinfo_create() only returns if successful.
+	 * Though `pixmap' is the window's background, what becomes of
+	 * drawing into a window's background pixmap after setting it is
+	 * undefined, so exposed areas are repainted from it by hand.  And
+	 * while the window is fully obscured, there's no drawing to it.
 	 */
-	ifp = ifinfo_create(ifname);
+	if (XGetWindowAttributes(DADisplay, DAWindow, &attrs)) {
+		XSelectInput(DADisplay, DAWindow, attrs.your_event_mask |
+		    ExposureMask | VisibilityChangeMask);
+	}
+
+	/*
+	 * Everything we wait on goes through one event loop; the sampling
+	 * schedule adds its timer while an interface is being monitored.
+	 */
+	evp = evloop_create();
+	evloop_add(evp, ConnectionNumber(DADisplay), WN_EV_X);
+	if (iflist_fd(iflp) != -1)
+		evloop_add(evp, iflist_fd(iflp), WN_EV_IFLIST);
+
+	/*
+	 * SIGUSR1 asks for a report of how often we've woken up.  Since
+	 * waiting in the event loop is never restarted after a signal, it's
+	 * noticed right away.
+	 */
+	wstats.start = nsnow();
+	(void) memset(&act, 0, sizeof (act));
+	act.sa_handler = onusr1;
+	(void) sigemptyset(&act.sa_mask);
+	(void) sigaction(SIGUSR1, &act, NULL);
+
+	/*
+	 * NOTE: ifdisp_create() only returns if successful.
+	 */
+	statep = if_statinit(statops);
+	if (statep == NULL)
+		die("cannot initialize interface statistics");
+
+	ifp = ifdisp_create(ifname, statep);
+
+	/*
+	 * Carry on from the saved state, if there is any (and it's for us);
+	 * either way, save it on the way out.  Since we're otherwise killed
+	 * by the usual signals, they just ask for an exit.  A replay has no
+	 * state worth keeping.
+	 */
+	if (statepath != NULL && if_statclock(statep, NULL) != 0)
+		statepath = NULL;
+
+	if (statepath != NULL) {
+		stateinterval = interval;
+		statebackend = statops->name;
+		statesaved = nsnow();
+		(void) ifstate_load(statepath, ifp, interval, statebackend);
+		if (atexit(state_save) != 0)
+			warn("cannot arrange to save state on exit\n");
+
+		act.sa_handler = onquit;
+		(void) sigaction(SIGTERM, &act, NULL);
+		(void) sigaction(SIGINT, &act, NULL);
+		(void) sigaction(SIGHUP, &act, NULL);
+	}
+
 	for (;;) {
-		ifinfo_monitor(ifp, siocfd, niter, interval, pixmap);
+		ifinfo_monitor(ifp, iflp, niter, interval, pixmap);
 		if ((!options[OPT_KEEP].used) &&
-		    (if_next(siocfd, ifname, nextifname))) {
-			ifinfo_destroy(ifp);
-			ifp = ifinfo_create(nextifname);
+		    (iflist_next(iflp, ifname, nextifname))) {
+			ifdisp_destroy(ifp);
+			ifp = ifdisp_create(nextifname, statep);
 			ifname = nextifname;
 		}
 	}
@@ -302,122 +506,221 @@ main(int argc, char **argv)
 	return (EXIT_SUCCESS);
 }
 
+/*
+ * Monitor the interface described by `ifp', sampling it every `interval'
+ * milliseconds (with `niter' smoothing iterations in between), until
+ * asked to move on to the next interface.  In adaptive mode, it's sampled
+ * several times an interval while busy, and only every few intervals
+ * while idle; either way, the graph gets one column per interval.
+ */
 static void
-ifinfo_monitor(ifinfo_t *ifp, int siocfd, unsigned int niter, int interval,
-    Pixmap pixbuf)
+ifinfo_monitor(ifinfo_t *ifp, iflist_t *iflp, unsigned int niter,
+    unsigned int interval, Pixmap pixbuf)
 {
-	struct timeval	start;
-	ifstats_t	stats, ostats, *curstats;
-	int		msec;
-	unsigned int	iter;
+	ifsample_t	sample;
+	ifstats_t	colstats;
+	ifrates_t	colrate, ocolrate;
+	double		rx, tx;
+	ifstatus_t	status;
+	int		replay;
+	unsigned int	iter, due, ncols;
+	unsigned int	sub = 0, nsub = 1, nidle = 1;
 	XEvent		event;
 	ulonglong_t	realbps;
+	ulonglong_t	colstamp;
+	sched_t		*schedp;
+	int		schedfd;
+
+	/*
+	 * When replaying a trace, there's no point in waiting around
+	 * between samples (or smoothing between them); just go as fast as
+	 * we can, stopping only to handle events.
+	 */
+	replay = (if_statclock(ifp->statep, NULL) != 0);
 
-	ifp->status = if_status(siocfd, ifp->name);
-	(void) if_stats(ifp->name, ifp->statep, &ostats);
+	/*
+	 * The microburst sampler has to hold enough samples for the
+	 * longest a column can take, which is longest when idling.
+	 */
+	if (burstops != NULL && !replay)
+		burstp = burst_create(burstops, ifp->name, burstms, interval *
+		    (options[OPT_ADAPTIVE].used ? WN_ADAPT_MAXIDLE : 1));
+
+	if (ifdisp_sample(ifp, iflp, &sample))
+		ifinfo_update(ifp, &sample);
+
+	/*
+	 * After a warm start, the first sample spans the time we were gone,
+	 * so it has a rate right away; show it the way periods that went by
+	 * without a sample always are.
+	 */
+	if (ifp->elapsed != 0) {
+		ifp->bps = ifp->rate.rxbytes + ifp->rate.txbytes;
+		ncols = ifp->graph->ncols;
+		if (ifp->elapsed / (interval * 1000000ULL) < ncols)
+			ncols = ifp->elapsed / (interval * 1000000ULL);
+		while (ncols-- > 0)
+			ifgraph_add(ifp->graph, &ifp->rate);
+	}
 	realbps = 0;
+	colstats = ifp->stats;
+	colstamp = ifp->last.stamp;
+	(void) memset(&colrate, 0, sizeof (colrate));
 
 	draw_dockapp(ifp, WN_DRAWALL, pixbuf);
 
+	/*
+	 * Each column's sample is taken at the end of a period of the
+	 * schedule; smoothing iteration `iter' falls `timetable[iter]'
+	 * milliseconds before that.
+	 */
+	schedp = sched_create(interval);
+	if (sched_fd(schedp) != -1)
+		evloop_add(evp, sched_fd(schedp), WN_EV_TIMEOUT);
+
 	for (;;) {
-		(void) gettimeofday(&start, NULL);
+		/*
+		 * The next sample is due `sub' `nsub'ths of the way through
+		 * this period, or at the end of the `nidle'th one from now.
+		 * Only a sample that's a plain period away gets smoothed.
+		 */
+		sub++;
+		due = (sub == nsub) ? interval * nidle : interval / nsub * sub;
+
 		iter = 1;
 		for (;;) {
 			/*
 			 * Skip the remaining smoothing iterations if
 			 * we're already at the actual bps value.
 			 */
-			if (ifp->bps == realbps)
+			if (ifp->bps == realbps || replay || due != interval)
 				iter = niter;
 
-			msec = next_timeout(timetable, iter, &start,
-			    interval * 1000);
-
-			if (!DANextEventOrTimeout(&event, msec)) {
-				if (++iter > niter)
+			/*
+			 * If the timer gives out, the schedule goes on with
+			 * timeouts, and its descriptor is no longer ours to
+			 * watch.
+			 */
+			schedfd = sched_fd(schedp);
+			if (!sched_arm(schedp, replay ? 0 : (iter == niter ?
+			    due : interval - timetable[iter])))
+				evloop_del(evp, schedfd);
+
+			switch (nextevent(&event, schedp)) {
+			case WN_EV_TIMEOUT:
+				if (iter == niter)
 					break;
 
-				next_bps(smoothtable, iter, niter, ifp);
+				next_bps(smoothtable, ++iter, niter, ifp);
 				draw_dockapp(ifp, WN_DRAWBPS, pixbuf);
-			} else {
+				continue;
+
+			case WN_EV_X:
+				if (draw_event(&event, pixbuf))
+					continue;
 				DAProcessEvent(&event);
 				if (bpflags & WN_BP_REDRAW)
 					draw_dockapp(ifp, WN_DRAWALL, pixbuf);
 				if (bpflags & WN_BP_NEXTIF) {
 					bpflags = 0;
+					evloop_del(evp, sched_fd(schedp));
+					sched_destroy(schedp);
+					if (burstp != NULL) {
+						burst_destroy(burstp);
+						burstp = NULL;
+					}
 					return;
 				}
 				bpflags = 0;
+				continue;
+
+			case WN_EV_IFLIST:
+				/*
+				 * Show link flaps as soon as we hear about
+				 * them rather than at the next sample.
+				 */
+				if (!iflist_update(iflp))
+					continue;
+
+				status = if_status(iflp, ifp->name, -1);
+				if (status != ifp->status) {
+					ifp->status = status;
+					draw_dockapp(ifp, WN_DRAWALL, pixbuf);
+				}
+				continue;
+
+			default:
+				continue;
 			}
+			break;
 		}
 
-		ifp->status = if_status(siocfd, ifp->name);
-
-		if (if_stats(ifp->name, ifp->statep, &stats) == 0) {
-			ifp->status = IF_UNKNOWN;
-			stats = ostats;
+		/*
+		 * At the end of a period, the schedule moves on; any periods
+		 * that went by without a sample (because we were idling, or
+		 * the machine was too busy to run us) still get columns.  A
+		 * replay never waits, so its schedule stays put.
+		 */
+		ncols = 0;
+		if (sub == nsub)
+			ncols = replay ? 1 : 1 + sched_next(schedp);
+
+		if (!ifdisp_sample(ifp, iflp, &sample))
+			sample = ifp->last;
+		wstats.samples++;
+
+		if (replay && if_statclock(ifp->statep, NULL) == -1)
+			exit(EXIT_SUCCESS);	/* trace is over */
+
+		ifinfo_update(ifp, &sample);
+		if (ifp->elapsed != 0) {
+			ifgraph_sample(ifp->graph, ifp->rate.rxbytes,
+			    ifp->rate.txbytes);
+			if (archp != NULL) {
+				ifarch_update(archp, time(NULL), ifp->elapsed,
+				    &ifp->rate);
+			}
 		}
 
-		ifp->graph->col = WN_MODINC(ifp->graph->col, WN_GR_COLS);
-		curstats = &ifp->graph->stats[ifp->graph->col];
-		curstats->rxbytes = (stats.rxbytes - ostats.rxbytes) / interval;
-		curstats->txbytes = (stats.txbytes - ostats.txbytes) / interval;
-		ostats = stats;
-
-		realbps = curstats->rxbytes + curstats->txbytes;
-		next_bps(smoothtable, 1, niter, ifp);
 		/*
-		 * XXX: This should really be WN_DRAWBPS | WN_DRAWGRAPH,
-		 * but if we get covered up and then exposed, we don't get
-		 * an expose event, so we don't know to redraw the
-		 * interface name.  So, for now, we just pessimistically
-		 * redraw the whole damn thing.  ARG!
+		 * Each column shows the rate over the whole time it covers,
+		 * however many samples that took, along with the highest
+		 * and lowest of them (and of the microburst sampler's).
 		 */
-		draw_dockapp(ifp, WN_DRAWALL, pixbuf);
-	}
-}
-
-static unsigned int
-next_timeout(unsigned int timetable[], unsigned int iter, struct timeval *start,
-    unsigned int interval)
-{
-	struct timeval	elapsed, current;
-	unsigned int	msspent;
-
-	(void) gettimeofday(&current, NULL);
+		if (ncols != 0) {
+			ocolrate = colrate;
+			if_statsrate(&ifp->stats, &colstats,
+			    ifp->last.stamp - colstamp, &colrate);
+			colstats = ifp->stats;
+			colstamp = ifp->last.stamp;
+			while (burstp != NULL && burst_next(burstp, &rx, &tx))
+				ifgraph_sample(ifp->graph, rx, tx);
+			while (ncols-- > 0)
+				ifgraph_add(ifp->graph, &colrate);
+			sub = 0;
+
+			if (options[OPT_ADAPTIVE].used && !replay)
+				next_adapt(&colrate, &ocolrate, interval, &nsub,
+				    &nidle);
+
+			if (statepath != NULL &&
+			    nsnow() - statesaved >= WN_STATE_SAVENS)
+				state_save();
+		}
 
-	elapsed.tv_sec  = current.tv_sec  - start->tv_sec;
-	elapsed.tv_usec = current.tv_usec - start->tv_usec;
-	if (elapsed.tv_usec < 0) {
-		elapsed.tv_sec--;
-		elapsed.tv_usec += 1000000; /* one second */
+		/*
+		 * A rolling window is already as steady as it's going to
+		 * get, so there's no smoothing it.
+		 */
+		if (meterwin != -1) {
+			(void) ifinfo_window(ifp, meterwin, &rx, &tx);
+			ifp->bps = realbps = rx + tx;
+		} else {
+			realbps = ifp->rate.rxbytes + ifp->rate.txbytes;
+			next_bps(smoothtable, 1, niter, ifp);
+		}
+		draw_dockapp(ifp, WN_DRAWBPS | WN_DRAWGRAPH, pixbuf);
 	}
-
-	msspent = elapsed.tv_sec * 1000 + (elapsed.tv_usec / 1000);
-	if (timetable[iter] + msspent > interval)
-		return (0);
-
-	return ((interval - msspent) - timetable[iter]);
-}
-
-/* XXX niter should be part of smoothtable */
-static void
-next_bps(double smoothtable[], unsigned int iter, unsigned int niter,
-    ifinfo_t *ifp)
-{
-	ifstats_t	*stats = ifp->graph->stats;
-	unsigned int	col = ifp->graph->col;
-	unsigned int	ocol = WN_MODDEC(col, WN_GR_COLS);
-	long long	num;
-	long long	onum;
-
-	num = stats[col].rxbytes + stats[col].txbytes;
-	onum = stats[ocol].rxbytes + stats[ocol].txbytes;
-
-	if (iter < niter)
-		ifp->bps += (num - onum) * smoothtable[niter + 1 - iter];
-	else
-		ifp->bps = num;
 }
 
 /*
@@ -448,6 +751,10 @@ draw_dockapp(ifinfo_t *ifp, unsigned int flags, Pixmap pixbuf)
 {
 	Pixmap		background = backlight_off;
 	unsigned int	odispflags = dispflags;
+#ifdef	WN_RENDER_STATS
+	unsigned long	request = XNextRequest(DADisplay);
+	long long	start = nsnow();
+#endif
 
 	/*
 	 * Enable or disable the alarm, as appropriate.
@@ -499,10 +806,35 @@ draw_dockapp(ifinfo_t *ifp, unsigned int flags, Pixmap pixbuf)
 		flags = WN_DRAWALL;
 
 	/*
-	 * Copy the current background to pixmap so we can modify it
-	 * according to `flags'.
+	 * Only redraw the parts of the frame that would look different
+	 * from the last one (if any).  Nothing changing is the usual case
+	 * on an idle link, where the meter is stuck at zero and the graph
+	 * is flat.
+	 */
+	flags = draw_changed(ifp, flags, background);
+	if (flags == 0) {
+		wstats.skipped++;
+		return;
+	}
+	wstats.frames++;
+
+	/*
+	 * The rest of `pixbuf' still holds the last frame; restore just
+	 * the parts being redrawn from the current background.
 	 */
-	WN_XCopyArea(background, pixbuf, WN_DA_WIDTH, WN_DA_HEIGHT, 0, 0);
+	if (flags == WN_DRAWALL) {
+		WN_XCopyArea(background, pixbuf, WN_DA_WIDTH, WN_DA_HEIGHT,
+		    0, 0);
+	} else {
+		if (flags & WN_DRAWBPS) {
+			WN_XCopyArea(background, pixbuf, WN_BPS_WIDTH,
+			    WN_BPS_HEIGHT, WN_BPS_XOFF, WN_BPS_YOFF);
+		}
+		if (flags & WN_DRAWGRAPH) {
+			WN_XCopyArea(background, pixbuf, WN_GR_WIDTH,
+			    WN_GR_HEIGHT, WN_GR_XOFF, WN_GR_YOFF);
+		}
+	}
 
 	/*
 	 * If the interface is up, draw the throughput and activity graph.
@@ -517,11 +849,119 @@ draw_dockapp(ifinfo_t *ifp, unsigned int flags, Pixmap pixbuf)
 
 		if (flags & WN_DRAWGRAPH)
 			draw_graph(ifp->graph, pixbuf);
+		else if (flags & WN_DRAWSCROLL)
+			draw_scroll(ifp->graph, lastframe.scroll, background,
+			    pixbuf);
 	}
 
 	if ((dispflags & WN_DISP_IFNAME) && (flags & WN_DRAWIFNAME))
 		draw_ifname(ifp->name, pixbuf);
 
+	draw_window(flags, pixbuf);
+
+#ifdef	WN_RENDER_STATS
+	rstats.ns += nsnow() - start;
+	rstats.requests += XNextRequest(DADisplay) - request;
+	rstats.frames++;
+#endif
+}
+
+/*
+ * Work out what drawing the parts of the interface described by `ifp'
+ * named by `flags' over `background' would show, and note it as the last
+ * frame drawn.  Return the draw_dockapp() flags for the parts that look
+ * any different from the last frame: WN_DRAWALL if the whole thing has
+ * to be redrawn (say, the background changed, or WN_DRAWALL was asked
+ * for), or 0 if it'd all look just the same.  If all that happened to the
+ * graph is that it moved along, that's WN_DRAWSCROLL rather than
+ * WN_DRAWGRAPH, with the number of columns it moved along by noted in
+ * `lastframe.scroll'.
+ */
+static unsigned int
+draw_changed(ifinfo_t *ifp, unsigned int flags, Pixmap background)
+{
+	ifgraph_t	*graph = ifp->graph;
+	ifgcol_t	*colp;
+	bpslayout_t	layout;
+	unsigned int	c, col = graph->col, shift, n;
+	unsigned int	changed = 0;
+	unsigned char	tbars[WN_GR_COLS], rbars[WN_GR_COLS];
+	unsigned char	tpeaks[WN_GR_COLS], rpeaks[WN_GR_COLS];
+
+	if (!lastframe.valid || flags == WN_DRAWALL ||
+	    lastframe.dispflags != dispflags ||
+	    lastframe.background != background ||
+	    lastframe.status != ifp->status || lastframe.ifname != ifp->name)
+		changed = flags = WN_DRAWALL;
+
+	lastframe.valid = 1;
+	lastframe.dispflags = dispflags;
+	lastframe.background = background;
+	lastframe.status = ifp->status;
+	lastframe.ifname = ifp->name;
+
+	if (ifp->status != IF_UP)
+		return (changed);
+
+	if (flags & WN_DRAWBPS) {
+		(void) memset(&layout, 0, sizeof (layout));
+		bps_layout((dispflags & WN_DISP_INBYTES) ? ifp->bps :
+		    ifp->bps * 8, &layout);
+		if (memcmp(&layout, &lastframe.layout, sizeof (layout)) != 0) {
+			lastframe.layout = layout;
+			changed |= WN_DRAWBPS;
+		}
+	}
+
+	if (flags & WN_DRAWGRAPH) {
+		for (c = 0; c < WN_GR_COLS; c++) {
+			colp = &graph->cols[col];
+			tbars[c] = colp->tbar;
+			rbars[c] = colp->rbar;
+			tpeaks[c] = colp->tpeak;
+			rpeaks[c] = colp->rpeak;
+			col = WN_MODDEC(col, WN_GR_COLS);
+		}
+
+		/*
+		 * Usually, the columns still on the graph look just as they
+		 * did, only `shift' columns further along, so they can be
+		 * scrolled over rather than redrawn.  Otherwise (say, the
+		 * graph was rescaled), the lot has to be redrawn.
+		 */
+		shift = (graph->col + WN_GR_COLS - lastframe.col) % WN_GR_COLS;
+		n = WN_GR_COLS - shift;
+		if (changed != WN_DRAWALL) {
+			if (memcmp(&tbars[shift], lastframe.tbars, n) != 0 ||
+			    memcmp(&rbars[shift], lastframe.rbars, n) != 0 ||
+			    memcmp(&tpeaks[shift], lastframe.tpeaks, n) != 0 ||
+			    memcmp(&rpeaks[shift], lastframe.rpeaks, n) != 0)
+				changed |= WN_DRAWGRAPH;
+			else if (shift != 0)
+				changed |= WN_DRAWSCROLL;
+		}
+
+		(void) memcpy(lastframe.tbars, tbars, WN_GR_COLS);
+		(void) memcpy(lastframe.rbars, rbars, WN_GR_COLS);
+		(void) memcpy(lastframe.tpeaks, tpeaks, WN_GR_COLS);
+		(void) memcpy(lastframe.rpeaks, rpeaks, WN_GR_COLS);
+		lastframe.col = graph->col;
+		lastframe.scroll = shift;
+	}
+
+	return (changed);
+}
+
+/*
+ * Copy the parts of `pixbuf' named by `flags' to the dockapp's window,
+ * unless it's fully obscured.
+ */
+static void
+draw_window(unsigned int flags, Pixmap pixbuf)
+{
+	if (obscured)
+		return;
+
 	/*
 	 * If WN_DRAWALL is set, then just copy the whole image.
 	 * Otherwise, copy back just the requested pieces.
@@ -536,7 +976,7 @@ draw_dockapp(ifinfo_t *ifp, unsigned int flags, Pixmap pixbuf)
 		    WN_BPS_XOFF, WN_BPS_YOFF);
 	}
 
-	if (flags & WN_DRAWGRAPH) {
+	if (flags & (WN_DRAWGRAPH | WN_DRAWSCROLL)) {
 		WN_XCopyArea(pixbuf, DAWindow, WN_GR_WIDTH, WN_GR_HEIGHT,
 		    WN_GR_XOFF, WN_GR_YOFF);
 	}
@@ -549,6 +989,36 @@ draw_dockapp(ifinfo_t *ifp, unsigned int flags, Pixmap pixbuf)
 #endif
 }
 
+/*
+ * Handle the X event at `eventp' if it's about what of the dockapp's
+ * window can be seen: repaint any part of it that's exposed from
+ * `pixbuf', and note whether it's fully obscured.  Return 1 if it was
+ * handled, 0 if it's someone else's business.
+ */
+static int
+draw_event(XEvent *eventp, Pixmap pixbuf)
+{
+	if (eventp->xany.window != DAWindow)
+		return (0);
+
+	switch (eventp->type) {
+	case Expose:
+		if (!obscured) {
+			XCopyArea(DADisplay, pixbuf, DAWindow, DAGC,
+			    eventp->xexpose.x, eventp->xexpose.y,
+			    eventp->xexpose.width, eventp->xexpose.height,
+			    eventp->xexpose.x, eventp->xexpose.y);
+		}
+		return (1);
+
+	case VisibilityNotify:
+		obscured = (eventp->xvisibility.state ==
+		    VisibilityFullyObscured);
+		return (1);
+	}
+	return (0);
+}
+
 /*
  * Draw the interface name, using the passed in value.
  */
@@ -615,41 +1085,18 @@ draw_ifname(const char *ifname, Pixmap pixbuf)
 static void
 draw_bps(ulonglong_t bps, Pixmap pixbuf)
 {
-	unsigned int	tens = 0;
-	unsigned int	decplace = 0;
-	int		digit;
-
-	if (bps > 10)
-		tens++;
-	if (bps > 100)
-		tens++;
-	while (bps >= 1000) {
-		tens++;
-		decplace = WN_MODINC(decplace, 3);
-		bps /= 10;
-	}
+	bpslayout_t	layout;
+	unsigned int	place;
 
-	/*
-	 * Ceiling the maximum throughput at 999 gbps for now.
-	 */
-	if (tens > 11) {
-		tens = 11;
-		bps = 999;
-		decplace = 0;
-	}
+	bps_layout(bps, &layout);
 
-	draw_speed(tens, pixbuf);
-
-	if (bps == 0) {
-		draw_digit(0, 2, pixbuf);
-		return;
-	}
+	draw_speed(layout.tens, pixbuf);
 
-	if (decplace > 0 || tens < 3)
-		draw_decimal(decplace, pixbuf);
+	if (layout.decplace != -1)
+		draw_decimal(layout.decplace, pixbuf);
 
-	for (digit = 2; digit >= 0; digit--, bps /= 10)
-		draw_digit(bps % 10, digit, pixbuf);
+	for (place = layout.first; place < WN_BPS_NDIGITS; place++)
+		draw_digit(layout.digits[place], place, pixbuf);
 }
 
 /*
@@ -700,323 +1147,214 @@ draw_speed(unsigned int tens, Pixmap pixbuf)
 }
 
 /*
- * Rescale the ifgraph_t pointed to by `graph'.
+ * Draw the network activity graph using the interface graph statistics
+ * pointed to by `graph'.
  */
 static void
-rescale_graph(ifgraph_t *graph)
+draw_graph(ifgraph_t *graph, Pixmap pixbuf)
 {
-	unsigned int	col;
-	ulonglong_t	maxbytes = 0, bytes = 0;
-	ulonglong_t	scale = graph->bps2bar;
+	int		c;
+	unsigned int	col = graph->col;
 
-	/*
-	 * First, find the biggest value...
-	 */
-	for (col = 0; col < WN_GR_COLS; col++) {
-		bytes = graph->stats[col].txbytes + graph->stats[col].rxbytes;
-		if (bytes >= maxbytes) {
-			maxbytes = bytes;
-			graph->maxcol = col;
-		}
+	for (c = WN_GR_COLS - 1; c >= 0; c--) {
+		draw_column(&graph->cols[col], c, pixbuf);
+		col = WN_MODDEC(col, WN_GR_COLS);
 	}
+}
 
-	if ((maxbytes / scale) >= (WN_COL_HEIGHT - 1)) {
-		while ((maxbytes / scale) >= (WN_COL_HEIGHT - 1))
-			scale *= 2;
-	} else {
-		/*
-		 * See if we need to scale down.
-		 */
-		while (scale > WN_DEF_BPS2BAR) {
-			if ((maxbytes / (scale / 2)) >= (WN_COL_HEIGHT - 1))
-				break;
-			scale /= 2;
-		}
-	}
+/*
+ * Bring the network activity graph in `pixbuf' up to date with `graph'
+ * when all that's happened is that it's moved along by `shift' columns:
+ * scroll the columns still on it left with one copy, and draw just the
+ * new ones over `background'.  Each look's background repeats every
+ * column across the graph, so scrolling it along doesn't show.
+ */
+static void
+draw_scroll(ifgraph_t *graph, unsigned int shift, Pixmap background,
+    Pixmap pixbuf)
+{
+	unsigned int	width = (WN_GR_COLS - shift) * WN_COL_SPACE;
+	unsigned int	c, col = graph->col;
 
-	if (scale != graph->bps2bar) {
-		for (col = 0; col < WN_GR_COLS; col++) {
-			graph->tbars[col] = graph->stats[col].txbytes / scale;
-			graph->rbars[col] = graph->stats[col].rxbytes / scale;
-		}
-		graph->bps2bar = scale;
+	XCopyArea(DADisplay, pixbuf, pixbuf, DAGC,
+	    WN_COL_DXOFF + shift * WN_COL_SPACE, WN_COL_DYOFF,
+	    width, WN_COL_HEIGHT, WN_COL_DXOFF, WN_COL_DYOFF);
+
+	XCopyArea(DADisplay, background, pixbuf, DAGC,
+	    WN_COL_DXOFF + width, WN_COL_DYOFF,
+	    shift * WN_COL_SPACE, WN_COL_HEIGHT,
+	    WN_COL_DXOFF + width, WN_COL_DYOFF);
+
+	for (c = WN_GR_COLS; c-- > WN_GR_COLS - shift; ) {
+		draw_column(&graph->cols[col], c, pixbuf);
+		col = WN_MODDEC(col, WN_GR_COLS);
 	}
 }
 
 /*
-* Draw the network activity graph using the interface graph statistics
- * pointed to by `graph'.
+ * Draw the graph column pointed to by `colp' as the `c'th column from the
+ * left.  Transmit bars rise from the bottom and receive bars hang from
+ * the top; where a column's peak went beyond its (mean) bar, it's marked
+ * with a single row of the bar at the peak's height.
  */
 static void
-draw_graph(ifgraph_t *graph, Pixmap pixbuf)
+draw_column(const ifgcol_t *colp, unsigned int c, Pixmap pixbuf)
 {
-	int		c;
-	unsigned int	sxoff;
-	unsigned int	col = graph->col;
-	ulonglong_t	*tbars = graph->tbars;
-	ulonglong_t	*rbars = graph->rbars;
-
-	tbars[col] = graph->stats[col].txbytes / graph->bps2bar;
-	rbars[col] = graph->stats[col].rxbytes / graph->bps2bar;
-
-	/*
-	 * If the column we just collected either is too large to fit
-	 * in the graph or is replacing a column that was previously
-	 * the biggest value, then rescale.
-	 */
-	if (((tbars[col] + rbars[col]) >= (WN_COL_HEIGHT - 1)) ||
-	    (col == graph->maxcol))
-		rescale_graph(graph);
+	unsigned int	sxoff = WN_COL_SXOFF;
+	unsigned int	dxoff = WN_COL_DXOFF + (c * WN_COL_SPACE);
 
-	sxoff = WN_COL_SXOFF;
 	if (dispflags & WN_DISP_BACKLIT)
 		sxoff += WN_COL_WIDTH;
 
-	for (c = WN_GR_COLS - 1; c >= 0; c--) {
-		XCopyArea(DADisplay, parts, pixbuf, DAGC,
-		    sxoff, WN_COL_SYOFF + WN_COL_HEIGHT - tbars[col],
-		    WN_COL_WIDTH, tbars[col],
-		    WN_COL_DXOFF + (c * WN_COL_SPACE),
-		    WN_COL_DYOFF + WN_COL_HEIGHT - tbars[col]);
+	XCopyArea(DADisplay, parts, pixbuf, DAGC,
+	    sxoff, WN_COL_SYOFF + WN_COL_HEIGHT - colp->tbar,
+	    WN_COL_WIDTH, colp->tbar,
+	    dxoff, WN_COL_DYOFF + WN_COL_HEIGHT - colp->tbar);
+
+	XCopyArea(DADisplay, parts, pixbuf, DAGC,
+	    sxoff, WN_COL_SYOFF, WN_COL_WIDTH, colp->rbar,
+	    dxoff, WN_COL_DYOFF);
 
+	if (colp->tpeak > colp->tbar) {
 		XCopyArea(DADisplay, parts, pixbuf, DAGC,
-		    sxoff, WN_COL_SYOFF, WN_COL_WIDTH, rbars[col],
-		    WN_COL_DXOFF + (c * WN_COL_SPACE), WN_COL_DYOFF);
+		    sxoff, WN_COL_SYOFF, WN_COL_WIDTH, 1,
+		    dxoff, WN_COL_DYOFF + WN_COL_HEIGHT - colp->tpeak);
+	}
 
-		col = WN_MODDEC(col, WN_GR_COLS);
+	if (colp->rpeak > colp->rbar) {
+		XCopyArea(DADisplay, parts, pixbuf, DAGC,
+		    sxoff, WN_COL_SYOFF, WN_COL_WIDTH, 1,
+		    dxoff, WN_COL_DYOFF + colp->rpeak - 1);
 	}
 }
 
 /*
- * Create an ifinfo_t for an interface named `ifname'.  If it returns,
- * the pointer returned is guaranteed to be valid.
+ * Create an ifinfo_t for an interface named `ifname', gathering its stats
+ * through `statep', along with the graph we display it with.  If it
+ * returns, the pointer returned is guaranteed to be valid.  When keeping
+ * archives, the interface's is opened too (unless we're replaying a trace,
+ * which has no business in one); if that fails, we just go without.
  */
 static ifinfo_t *
-ifinfo_create(const char *ifname)
+ifdisp_create(const char *ifname, ifstat_t *statep)
 {
-	ifinfo_t *ifp;
-
-	ifp = calloc(1, sizeof (ifinfo_t));
-	if (ifp == NULL)
-		die("cannot allocate interface information structure");
+	ifinfo_t	*ifp;
+	char		path[PATH_MAX];
 
-	ifp->name = strdup(ifname);
-	if (ifp->name == NULL)
-		die("cannot allocate interface name");
+	ifp = ifinfo_create(ifname, statep);
 
-	ifp->graph = calloc(1, sizeof (ifgraph_t));
-	if (ifp->graph == NULL)
-		die("cannot allocate interface statistics graph");
-	ifp->graph->bps2bar = WN_DEF_BPS2BAR;
+	ifp->graph = ifgraph_create(WN_GR_COLS, WN_COL_HEIGHT, WN_DEF_BPS2BAR,
+	    options[OPT_SCALEPEAK].used ? IFG_SCALEPEAK : IFG_SCALEMEAN);
+	stateifp = ifp;
 
-	ifp->statep = if_statinit();
-	if (ifp->statep == NULL)
-		die("cannot initialize interface statistics");
+	if (archdir != NULL && if_statclock(statep, NULL) == 0) {
+		(void) snprintf(path, sizeof (path), "%s/%s", archdir, ifname);
+		archp = ifarch_open(path, ifname);
+	}
 
 	return (ifp);
 }
 
 /*
- * Destroy the ifinfo_t pointed to by `ifp'.
+ * Destroy the ifinfo_t pointed to by `ifp', along with its graph and its
+ * archive (if any).
  */
 static void
-ifinfo_destroy(ifinfo_t *ifp)
+ifdisp_destroy(ifinfo_t *ifp)
 {
-	if_statfini(ifp->statep);
-	free(ifp->name);
-	free(ifp->graph);
-	free(ifp);
-}
-
-/*
- * Check if the named interface is functioning.
- */
-static ifstatus_t
-if_status(int fd, const char *ifname)
-{
-	int flags = if_flags(fd, ifname);
-
-	if (flags == -1)
-		return (IF_UNKNOWN);
-
-	return ((flags & IFF_UP) != 0 ? IF_UP : IF_DOWN);
+	if (archp != NULL) {
+		ifarch_close(archp);
+		archp = NULL;
+	}
+	stateifp = NULL;
+	ifgraph_destroy(ifp->graph);
+	ifinfo_destroy(ifp);
+	lastframe.valid = 0;
 }
 
 /*
- * Get an interface's current flags, or -1 if the cannot be retrieved.
+ * Sample the stats on the interface described by `ifp' into `samplep', and
+ * update its status.  When recording, the sample is taken from a snapshot
+ * of every interface, which is appended to the trace.  Return 1 on
+ * success, 0 on failure.
  */
 static int
-if_flags(int fd, const char *ifname)
+ifdisp_sample(ifinfo_t *ifp, iflist_t *iflp, ifsample_t *samplep)
 {
-	struct ifreq ifr;
-
-	(void) strncpy(ifr.ifr_name, ifname, IFNAMSIZ);
-	ifr.ifr_name[IFNAMSIZ - 1] = '\0';
+	const ifstatsnap_t	*snap;
+	struct timeval		now;
 
-	if (ioctl(fd, SIOCGIFFLAGS, &ifr) == -1)
-		return (-1);
+	if (recp == NULL)
+		return (ifinfo_sample(ifp, iflp, samplep));
 
-	return (ifr.ifr_flags);
-}
-
-/*
- * Return a pointer to the next ifreq structure after `ifrp'.  See the rant
- * in if_next() for more on this misery.
- */
-static struct ifreq *
-ifr_next(struct ifreq *ifrp)
-{
-	unsigned int len;
+	snap = if_statsall(ifp->statep);
+	if (snap == NULL) {
+		ifp->status = IF_UNKNOWN;
+		return (0);
+	}
 
-#ifdef	HAVE_SOCKADDR_SA_LEN
-	len = ifrp->ifr_addr.sa_len;
-	if (len < sizeof (struct sockaddr))
-		len = sizeof (struct sockaddr);
-#else
-	switch (ifrp->ifr_addr.sa_family) {
-#ifdef	HAVE_IPV6
-	case AF_INET6:
-		len = sizeof (struct sockaddr_in6);
-		break;
-#endif
-	case AF_INET:
-	default:
-		len = sizeof (struct sockaddr);
-		break;
+	(void) if_statclock(ifp->statep, &now);
+	if (!ifrec_write(recp, &now, snap)) {
+		warn("cannot write trace; recording stopped");
+		ifrec_close(recp);
+		recp = NULL;
 	}
-#endif
-	len += sizeof (ifrp->ifr_name);
-	return ((struct ifreq *)((caddr_t)ifrp + len));
+
+	return (ifinfo_snapsample(ifp, iflp, snap, samplep));
 }
 
 /*
- * Fetch the name of the "next" interface in the interface list.  If the
- * passed in interface name is empty, then return the first interface name
- * in the list that isn't loopback (unless loopback is the only interface).
- * If the next interface name cannot be determined, then 0 is returned.
+ * Wait until the deadline `schedp' is armed with, or for something else
+ * to happen.  This is DANextEventOrTimeout(), except that everything else
+ * registered with the event loop is waited on too, and it doesn't force a
+ * round trip to the X server each time.  If an X event arrives, it's
+ * stored in `eventp'.  Returns one of the WN_EV_* values.
  */
 static int
-if_next(int fd, const char *ifname, char *nextifname)
+nextevent(XEvent *eventp, sched_t *schedp)
 {
-	struct ifconf	ifc;
-	struct ifreq	*ifrp, *matchifrp = NULL, *loifrp;
-	void		*startp, *endp;
-	int		flags;
-	int		ifcount;
-	int		prevlen;
+	if (wquit)
+		exit(EXIT_SUCCESS);
 
-	/*
-	 * Fetch the number of interfaces on the system.
-	 */
-#ifdef	SIOCGIFNUM
-	if (ioctl(fd, SIOCGIFNUM, &ifcount) == -1)
-		return (0);
-	ifc.ifc_len = ifcount * sizeof (struct ifreq);
-#else
-	/*
-	 * Unfortunately, different flavors of Unix have different semantics
-	 * for when the buffer is too small.  Specifically, some (like Linux)
-	 * will set ifc_len to be the size that would be needed to return all
-	 * of the interface information, whereas others (like FreeBSD) will
-	 * set ifc_len to be the amount of ifc_buf that was copied out to
-	 * userland.  Thus, we have to do this weird dance to support both.
-	 */
-	ifc.ifc_len = 0;
-	ifc.ifc_buf = NULL;
-	do {
-		prevlen = ifc.ifc_len;
-		ifc.ifc_len += 1024;
-		ifc.ifc_buf = realloc(ifc.ifc_buf, ifc.ifc_len);
-		if (ifc.ifc_buf == NULL) {
-			warn("cannot allocate interface information");
-			return (0);
-		}
-		if (ioctl(fd, SIOCGIFCONF, &ifc) == -1 || ifc.ifc_len <= 0) {
-			free(ifc.ifc_buf);
-			return (0);
-		}
-	} while (ifc.ifc_len > prevlen);
-
-	free(ifc.ifc_buf);
-#endif
-	/*
-	 * Allocate enough ifreq entries to store the results.
-	 */
-	ifc.ifc_req = alloca(ifc.ifc_len);
-	if (ioctl(fd, SIOCGIFCONF, &ifc) == -1)
-		return (0);
+	if (wreport) {
+		wreport = 0;
+		wakeup_report();
+	}
 
 	/*
-	 * *@@!*(&#$: A special thanks to the BSD team, for breaking the
-	 * SIOCGIFCONF interface when they introduced IPv6 support, by
-	 * making ifreqs vary in size.  To make matters worse, most Unices
-	 * do not support sa_len, so we don't even have a portable way to
-	 * step through the ifreqs.  Why BSD didn't just introduce a new
-	 * ioctl to retrieve the extended ifreqs is beyond me.
+	 * Xlib may already have read events off the connection, in which
+	 * case it won't become readable for them.
 	 */
-	startp = ifc.ifc_buf;
-	endp = ifc.ifc_buf + ifc.ifc_len;
+	if (XPending(DADisplay)) {
+		XNextEvent(DADisplay, eventp);
+		return (WN_EV_X);
+	}
 
 	/*
-	 * Loop through all the interface names.  If we were given an
-	 * interface name, then attempt to return the next interface
-	 * "after" it (looping around to the first interface, if need be).
-	 * If we weren't given an interface name, or if we cannot find the
-	 * requested interface name, then return the first non-loopback
-	 * interface.
+	 * Either the schedule's timer is registered with the event loop, or
+	 * we have to time out ourselves.
 	 */
-	for (ifrp = startp; (void *)&ifrp[1] <= endp; ifrp = ifr_next(ifrp)) {
-		if (ifname != NULL && strcmp(ifrp->ifr_name, ifname) == 0) {
-			/*
-			 * Each interface ends up in the ifreq list once
-			 * for each address family it's configured with.
-			 * If these entries end up being consecutive, that
-			 * will screw up our iterator since we iterate
-			 * by name.  As such, make sure we skip to the
-			 * final instance of the name we find.
-			 */
-			matchifrp = ifrp;
-			do {
-				matchifrp = ifr_next(matchifrp);
-				if ((void *)&matchifrp[1] > endp)
-					matchifrp = startp;
-			} while (matchifrp != ifrp &&
-			    strcmp(ifrp->ifr_name, matchifrp->ifr_name) == 0);
-			break;
-		}
+	switch (evloop_wait(evp, sched_timeout(schedp))) {
+	case WN_EVLOOP_NONE:
+	case WN_EV_TIMEOUT:
+		return (sched_expired(schedp) ? WN_EV_TIMEOUT : WN_EV_NONE);
 
-		/*
-		 * Just in case we never find a non-loopback interface,
-		 * keep track of the first loopback interface we find.
-		 */
-		flags = if_flags(fd, ifrp->ifr_name);
-		if (flags != -1 && (flags & IFF_LOOPBACK)) {
-			if (loifrp == NULL)
-				loifrp = ifrp;
-			continue;
-		}
+	case WN_EV_IFLIST:
+		return (WN_EV_IFLIST);
 
+	case WN_EV_X:
 		/*
-		 * If this is the first non-loopback interface we've found,
-		 * then store it in `matchifrp' in case we don't find a
-		 * better match.
+		 * The X connection may have become readable with something
+		 * other than a complete event, in which case there's nothing
+		 * to do yet.
 		 */
-		if (matchifrp == NULL) {
-			matchifrp = ifrp;
-			if (ifname == NULL)
-				break;
+		if (XPending(DADisplay)) {
+			XNextEvent(DADisplay, eventp);
+			return (WN_EV_X);
 		}
+		break;
 	}
-
-	if (matchifrp == NULL)
-		matchifrp = loifrp;
-
-	if (matchifrp != NULL) {
-		(void) strncpy(nextifname, matchifrp->ifr_name, IFNAMSIZ);
-		nextifname[IFNAMSIZ - 1] = '\0';
-		return (1);
-	}
-	return (0);
+	return (WN_EV_NONE);
 }
 
 /*
@@ -1080,54 +1418,6 @@ setshape(void)
 	}
 }
 
-/*
- * Initialize a smoothing table containing `niter + 1' elements.
- */
-static double *
-smoothtable_init(unsigned int niter)
-{
-	unsigned int iter;
-	unsigned int nslice = 0;
-	double *smoothtable;
-
-	smoothtable = calloc(niter + 1, sizeof (double));
-	if (smoothtable == NULL)
-		return (NULL);
-
-	for (iter = 0; iter <= niter; iter++)
-		nslice += (iter * (iter + 1));
-
-	for (iter = 0; iter <= niter; iter++)
-		smoothtable[iter] = (double)(iter * (iter + 1)) / nslice;
-
-	return (smoothtable);
-}
-
-/*
- * Initialize the smoothing time table, using the general smoothing table
- * named by `smoothtable', the total amount of time per update interval (in
- * milliseconds, and the total number of smoothing iterations per update
- * interval.
- */
-static unsigned int *
-timetable_init(double smoothtable[], unsigned int interval, unsigned int niter)
-{
-	unsigned int *timetable;
-	unsigned int iter;
-
-	timetable = calloc(niter + 1, sizeof (unsigned int));
-	if (timetable == NULL)
-		return (NULL);
-
-	timetable[0] = interval;
-	for (iter = 1; iter < niter; iter++)
-		timetable[iter] = timetable[iter - 1] -
-		    (interval * smoothtable[iter]);
-	timetable[niter] = 0;
-
-	return (timetable);
-}
-
 /*
  * Given specified `red', `green', and `blue' values, return the closest
  * approximation to that value in the color table.  Only needed for
@@ -1232,3 +1522,122 @@ getblendedcolor(const char *colorname, int blend)
 
 	return (color.pixel);
 }
+
+/*
+ * Return the current time in nanoseconds, from the monotonic clock if
+ * there is one.
+ */
+static long long
+nsnow(void)
+{
+#ifdef	CLOCK_MONOTONIC
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000LL + ts.tv_nsec);
+#else
+	struct timeval tv;
+
+	(void) gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL);
+#endif
+}
+
+/* ARGSUSED */
+static void
+onusr1(int sig)
+{
+	wreport = 1;
+}
+
+/* ARGSUSED */
+static void
+onquit(int sig)
+{
+	wquit = 1;
+}
+
+/*
+ * Save the warm-start state of the interface being monitored, if there
+ * is one.  If it can't be saved, stop trying.
+ */
+static void
+state_save(void)
+{
+	statesaved = nsnow();
+	if (statepath == NULL || stateifp == NULL)
+		return;
+
+	if (!ifstate_save(statepath, stateifp, stateinterval, statebackend)) {
+		warn("cannot save state to %s; saving stopped", statepath);
+		statepath = NULL;
+	}
+}
+
+/*
+ * Report how often we've woken up, sampled and drawn since we started, on
+ * standard error.
+ */
+static void
+wakeup_report(void)
+{
+	double		secs = (nsnow() - wstats.start) / 1e9;
+	unsigned long	sampled, dropped;
+
+	if (secs <= 0)
+		return;
+
+	(void) fprintf(stderr, "%s: %.1fs: %.2f wakeups/s, %.2f samples/s, "
+	    "%.2f frames/s (%lu drawn, %lu skipped as unchanged)\n",
+	    progname, secs, evloop_wakeups(evp) / secs, wstats.samples / secs,
+	    wstats.frames / secs, wstats.frames, wstats.skipped);
+
+	if (burstp != NULL) {
+		burst_counts(burstp, &sampled, &dropped);
+		(void) fprintf(stderr, "%s: microburst sampler: %lu samples "
+		    "(%lu dropped)\n", progname, sampled, dropped);
+	}
+}
+
+#ifdef	WN_RENDER_STATS
+
+/*
+ * Note that function `func' issued an XCopyArea().  Each function's
+ * __func__ has a fixed address, so there's no need to compare names.
+ */
+static void
+rs_copyarea(const char *func)
+{
+	unsigned int i;
+
+	for (i = 0; i < rstats.nfuncs; i++) {
+		if (rstats.funcs[i] == func) {
+			rstats.copies[i]++;
+			return;
+		}
+	}
+
+	if (rstats.nfuncs < WN_RS_MAXFUNCS) {
+		rstats.funcs[rstats.nfuncs] = func;
+		rstats.copies[rstats.nfuncs++] = 1;
+	}
+}
+
+/*
+ * Report the rendering statistics on standard error, one "name value"
+ * pair per line, for xbench.sh to pick up.
+ */
+static void
+rs_report(void)
+{
+	unsigned int i;
+
+	(void) fprintf(stderr, "render-frames %lu\n", rstats.frames);
+	(void) fprintf(stderr, "render-ns %lld\n", rstats.ns);
+	(void) fprintf(stderr, "render-requests %lu\n", rstats.requests);
+	for (i = 0; i < rstats.nfuncs; i++) {
+		(void) fprintf(stderr, "render-copyarea %s %lu\n",
+		    rstats.funcs[i], rstats.copies[i]);
+	}
+}
+#endif
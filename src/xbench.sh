@@ -0,0 +1,110 @@
+#!/bin/sh
+#
+# Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+# SCCS  "@(#)xbench.sh	1.1	26/10/17 meem"
+#
+# End-to-end render benchmark: run the dockapp against a private Xvfb,
+# driven as fast as it will go from a synthetic trace, and report what
+# each frame costs.  Run it through `make xbench'; for the per-function
+# XCopyArea() counts, wmnetload must have been configured with
+# --enable-render-stats.
+#
+# Usage: xbench.sh [-n SAMPLES] [-d DISPLAYNUM]
+#
+# Results are printed in the same format as wnbench's:
+#
+#	BenchmarkRender	<frames>	<ns> ns/op	<value> <unit>/op ...
+#
+
+nsamples=10000
+dispnum=77
+
+while getopts n:d: opt; do
+	case $opt in
+	n)	nsamples=$OPTARG ;;
+	d)	dispnum=$OPTARG ;;
+	*)	echo "Usage: $0 [-n SAMPLES] [-d DISPLAYNUM]" >&2; exit 1 ;;
+	esac
+done
+
+if ! type Xvfb >/dev/null 2>&1; then
+	echo "$0: Xvfb is required" >&2
+	exit 1
+fi
+
+tmpdir=`mktemp -d /tmp/xbench.XXXXXX` || exit 1
+trap 'kill $xvfbpid 2>/dev/null; rm -rf $tmpdir' 0 1 2 15
+
+./wnbench -t $tmpdir/trace $nsamples || exit 1
+
+Xvfb :$dispnum -screen 0 320x240x24 -nolisten tcp >$tmpdir/xvfb.log 2>&1 &
+xvfbpid=$!
+
+#
+# Wait up to five seconds for the server to start listening.
+#
+tries=50
+while [ ! -S /tmp/.X11-unix/X$dispnum ]; do
+	tries=`expr $tries - 1`
+	if [ $tries -eq 0 ]; then
+		echo "$0: Xvfb did not start; see below" >&2
+		cat $tmpdir/xvfb.log >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+start=`date +%s%N`
+LD_PRELOAD=./xbench_shim.so WMNETLOAD_REPLAY=$tmpdir/trace \
+    ./wmnetload -d :$dispnum -ss replay -k -i bench0 2>$tmpdir/stats
+status=$?
+end=`date +%s%N`
+
+if [ $status -ne 0 ]; then
+	echo "$0: wmnetload failed" >&2
+	cat $tmpdir/stats >&2
+	exit 1
+fi
+
+#
+# Everything is reported per frame.  Without --enable-render-stats there
+# are no frame counts, so fall back to a frame per sample.
+#
+awk -v ns=`expr $end - $start` -v nsamples=$nsamples '
+	$1 == "render-frames"	{ frames = $2 }
+	$1 == "render-ns"	{ drawns = $2 }
+	$1 == "render-requests"	{ requests = $2 }
+	$1 == "render-copyarea"	{ copies[$2] = $3; ncopies += $3 }
+	$1 == "x-bytes"		{ bytes = $2 }
+	$1 == "x-writes"	{ writes = $2 }
+	$1 == "x-roundtrips"	{ roundtrips = $2 }
+	END {
+		stats = (frames > 0)
+		if (!stats)
+			frames = nsamples
+		printf("BenchmarkRender\t%d\t%.1f ns/op", frames, ns / frames)
+		if (stats)
+			printf("\t%.1f draw-ns/op\t%.2f requests/op" \
+			    "\t%.2f copyarea/op", drawns / frames,
+			    requests / frames, ncopies / frames)
+		printf("\t%.2f roundtrips/op\t%.1f B/op\t%.2f writes/op\n",
+		    roundtrips / frames, bytes / frames, writes / frames)
+		for (f in copies)
+			printf("BenchmarkRenderCopyArea/%s\t%d\t%.2f " \
+			    "copyarea/op\n", f, frames, copies[f] / frames)
+	}' $tmpdir/stats
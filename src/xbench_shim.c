@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2002 Peter Memishian (meem) <meem@gnu.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * xbench_shim - An LD_PRELOAD shim for the render benchmark (xbench.sh)
+ *		 that counts what a client costs its X server.
+ *
+ * Bytes are counted as they are written to stream sockets (which, in a
+ * dockapp, means the X connection), and round trips as the client waits
+ * for replies in xcb_wait_for_reply().  The totals are reported on
+ * standard error at exit, in the same "name value" form as the dockapp's
+ * own rendering statistics.  This is GNU/Linux-specific, and only ever
+ * built on demand by `make xbench'.
+ */
+
+#pragma ident "@(#)xbench_shim.c	1.1	26/10/17 meem"
+
+#define	_GNU_SOURCE
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define	XS_MAXFD	1024		/* highest descriptor we classify */
+
+enum { XS_UNKNOWN, XS_STREAM, XS_OTHER };
+
+static unsigned char	fdkind[XS_MAXFD];	/* XS_* for each descriptor */
+static unsigned long long xbytes;		/* bytes sent */
+static unsigned long	xwrites;		/* writes that sent them */
+static unsigned long	xroundtrips;		/* replies waited for */
+
+static ssize_t	(*real_write)(int, const void *, size_t);
+static ssize_t	(*real_writev)(int, const struct iovec *, int);
+static ssize_t	(*real_send)(int, const void *, size_t, int);
+static ssize_t	(*real_sendto)(int, const void *, size_t, int,
+    const struct sockaddr *, socklen_t);
+static ssize_t	(*real_sendmsg)(int, const struct msghdr *, int);
+static void	*(*real_wait)(void *, unsigned int, void **);
+static void	*(*real_wait64)(void *, unsigned long long, void **);
+
+/*
+ * Return 1 if `fd' is a stream socket.  Descriptors get reused, but a
+ * dockapp opens its X connection once and keeps it.
+ */
+static int
+xs_isstream(int fd)
+{
+	int		type;
+	socklen_t	len = sizeof (type);
+
+	if (fd < 0 || fd >= XS_MAXFD)
+		return (0);
+
+	if (fdkind[fd] == XS_UNKNOWN) {
+		if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0 &&
+		    type == SOCK_STREAM)
+			fdkind[fd] = XS_STREAM;
+		else
+			fdkind[fd] = XS_OTHER;
+	}
+	return (fdkind[fd] == XS_STREAM);
+}
+
+/*
+ * Note that `len' bytes were (or weren't, if -1) written to `fd'.
+ */
+static ssize_t
+xs_count(int fd, ssize_t len)
+{
+	if (len > 0 && xs_isstream(fd)) {
+		xbytes += len;
+		xwrites++;
+	}
+	return (len);
+}
+
+static void *
+xs_next(const char *sym)
+{
+	void *fn = dlsym(RTLD_NEXT, sym);
+
+	if (fn == NULL) {
+		(void) fprintf(stderr, "xbench_shim: cannot find %s\n", sym);
+		abort();
+	}
+	return (fn);
+}
+
+ssize_t
+write(int fd, const void *buf, size_t len)
+{
+	if (real_write == NULL)
+		real_write = xs_next("write");
+	return (xs_count(fd, real_write(fd, buf, len)));
+}
+
+ssize_t
+writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	if (real_writev == NULL)
+		real_writev = xs_next("writev");
+	return (xs_count(fd, real_writev(fd, iov, iovcnt)));
+}
+
+ssize_t
+send(int fd, const void *buf, size_t len, int flags)
+{
+	if (real_send == NULL)
+		real_send = xs_next("send");
+	return (xs_count(fd, real_send(fd, buf, len, flags)));
+}
+
+ssize_t
+sendto(int fd, const void *buf, size_t len, int flags,
+    const struct sockaddr *to, socklen_t tolen)
+{
+	if (real_sendto == NULL)
+		real_sendto = xs_next("sendto");
+	return (xs_count(fd, real_sendto(fd, buf, len, flags, to, tolen)));
+}
+
+ssize_t
+sendmsg(int fd, const struct msghdr *msg, int flags)
+{
+	if (real_sendmsg == NULL)
+		real_sendmsg = xs_next("sendmsg");
+	return (xs_count(fd, real_sendmsg(fd, msg, flags)));
+}
+
+void *
+xcb_wait_for_reply(void *c, unsigned int request, void **e)
+{
+	if (real_wait == NULL)
+		real_wait = xs_next("xcb_wait_for_reply");
+	xroundtrips++;
+	return (real_wait(c, request, e));
+}
+
+void *
+xcb_wait_for_reply64(void *c, unsigned long long request, void **e)
+{
+	if (real_wait64 == NULL)
+		real_wait64 = xs_next("xcb_wait_for_reply64");
+	xroundtrips++;
+	return (real_wait64(c, request, e));
+}
+
+static void __attribute__((destructor))
+xs_report(void)
+{
+	(void) fprintf(stderr, "x-bytes %llu\n", xbytes);
+	(void) fprintf(stderr, "x-writes %lu\n", xwrites);
+	(void) fprintf(stderr, "x-roundtrips %lu\n", xroundtrips);
+}